@@ -6,9 +6,10 @@
 
 using rectPoints = std::pair<cv::Rect, std::vector<cv::Point>>;
 
-static cv::Mat drawRectsAndPoints(const cv::Mat &img,
-                                  const std::vector<rectPoints> data) {
-  cv::Mat outImg;
+// outImg keeps its buffer when it already has the size of img
+static void drawRectsAndPoints(const cv::Mat &img,
+                               const std::vector<rectPoints> &data,
+                               cv::Mat &outImg) {
   img.convertTo(outImg, CV_8UC3);
 
   for (auto &d : data) {
@@ -18,12 +19,19 @@ static cv::Mat drawRectsAndPoints(const cv::Mat &img,
       cv::circle(outImg, pts[i], 3, cv::Scalar(0, 255, 255), 1);
     }
   }
+}
+
+static cv::Mat drawRectsAndPoints(const cv::Mat &img,
+                                  const std::vector<rectPoints> data) {
+  cv::Mat outImg;
+  drawRectsAndPoints(img, data, outImg);
   return outImg;
 }
 
 
-static cv::Mat getDrawFacesImage(const cv::Mat &img,
-                                  const std::vector<Face> &faces) {
+static void getDrawFacesImage(const cv::Mat &img,
+                              const std::vector<Face> &faces,
+                              cv::Mat &outImg) {
   std::vector<rectPoints> data;
   for (size_t i = 0; i < faces.size(); ++i) {
     std::vector<cv::Point> pts;
@@ -35,7 +43,14 @@ static cv::Mat getDrawFacesImage(const cv::Mat &img,
     auto d = std::make_pair(rect, pts);
     data.push_back(d);
   }
-  return drawRectsAndPoints(img, data);
+  drawRectsAndPoints(img, data, outImg);
+}
+
+static cv::Mat getDrawFacesImage(const cv::Mat &img,
+                                  const std::vector<Face> &faces) {
+  cv::Mat outImg;
+  getDrawFacesImage(img, faces, outImg);
+  return outImg;
 }
 
 
@@ -0,0 +1,40 @@
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include <chrono>
+#include <thread>
+
+
+/*
+    * Caps a loop at max_fps iterations per second. wait() sleeps only for what is left of the
+    * frame period after the work of the iteration, so pacing adds no latency when the work itself
+    * takes a full period. A max_fps of 0 never sleeps.
+*/
+class FramePacer {
+public:
+    explicit FramePacer(double max_fps)
+        : period_(max_fps > 0 ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                    std::chrono::duration<double>(1.0 / max_fps))
+                              : std::chrono::steady_clock::duration::zero()),
+          next_(std::chrono::steady_clock::now()) {}
+
+    void wait() {
+        if (period_ == std::chrono::steady_clock::duration::zero()) return;
+
+        const auto now = std::chrono::steady_clock::now();
+        next_ += period_;
+        if (next_ > now) {
+            std::this_thread::sleep_until(next_);
+        } else {
+            // fell behind, do not try to catch up with a burst
+            next_ = now;
+        }
+    }
+
+private:
+    std::chrono::steady_clock::duration period_;
+    std::chrono::steady_clock::time_point next_;
+};
+
+
+#endif // FRAME_PACER_HPP
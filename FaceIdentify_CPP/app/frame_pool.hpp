@@ -0,0 +1,90 @@
+#ifndef FRAME_POOL_HPP
+#define FRAME_POOL_HPP
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+/*
+    * Pool of reference counted frame buffers.
+    *
+    * acquire() hands out a writable cv::Mat, recycled from a released frame when one is free. The
+    * writer fills it (VideoCapture::read, cv::Mat::copyTo and create() keep the buffer when the
+    * size and type match, which they do for every frame of a stream), then shares it read-only as a
+    * Frame: the raw frame reaches the processing thread and the stream ring without being copied.
+    * When the last Frame referencing a buffer goes away the buffer returns to the pool.
+    *
+    * Consumers keep the Frame, not a cv::Mat header copy, for as long as they read the pixels. A
+    * buffer still referenced by such a header copy when it is released is not recycled.
+*/
+class FramePool {
+public:
+    using Frame = std::shared_ptr<const cv::Mat>;
+
+    // Keep up to max_free released buffers for reuse, free the rest
+    explicit FramePool(size_t max_free = 16)
+        : state_(std::make_shared<State>()) {
+        state_->max_free = max_free;
+    }
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // Writable buffer, holding whatever frame it held before (empty when newly allocated)
+    std::shared_ptr<cv::Mat> acquire() {
+        std::unique_ptr<cv::Mat> mat;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if (!state_->free.empty()) {
+                mat = std::move(state_->free.back());
+                state_->free.pop_back();
+            }
+        }
+        if (!mat) {
+            mat = std::make_unique<cv::Mat>();
+            state_->allocated.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // the pool may be gone by the time the last reference is dropped
+        std::weak_ptr<State> weak_state = state_;
+        return std::shared_ptr<cv::Mat>(mat.release(), [weak_state](cv::Mat* released) {
+            std::unique_ptr<cv::Mat> owned(released);
+            std::shared_ptr<State> state = weak_state.lock();
+            if (!state) return;
+            // pixels still referenced through a header copy must not be overwritten
+            if (owned->u && owned->u->refcount > 1) {
+                owned->release();
+            }
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->free.size() < state->max_free) {
+                state->free.push_back(std::move(owned));
+            }
+        });
+    }
+
+    // Buffers allocated since the pool was created
+    size_t allocated() const { return state_->allocated.load(std::memory_order_relaxed); }
+
+    // Released buffers waiting to be reused
+    size_t available() const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->free.size();
+    }
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<cv::Mat>> free;
+        size_t max_free = 0;
+        std::atomic<size_t> allocated{0};
+    };
+
+    std::shared_ptr<State> state_;
+};
+
+
+#endif // FRAME_POOL_HPP
@@ -1,20 +1,38 @@
 #include "config/camera_config.hpp"
 #include "config/models_config.hpp"
+#include "config/database_config.hpp"
 #include "camera/internal_camera.hpp"
 #include "camera/rtsp_camera.hpp"
 #include "mtcnn/detector.hpp"
 #include "embedding/face_embedding.hpp"
 #include "embedding/embedding_db.hpp"
 #include "draw.hpp"
+#include "frame_pacer.hpp"
+#include "frame_pool.hpp"
+#include "pipeline.hpp"
+#include "reorder_buffer.hpp"
+#include "spsc_ring.hpp"
 #include "stream.hpp"
+#include "work_stealing_queue.hpp"
 
 
 
-// for streaming
-static std::queue<cv::Mat> frame_queue;
-static std::mutex frame_queue_mutex;
-static std::queue<std::pair<cv::Mat, std::vector<std::vector<float>>>> processed_frame_queue;
-static std::mutex processed_frame_queue_mutex;
+// captured and drawn frames, shared read-only between the threads
+static FramePool frame_pool;
+
+// for streaming, each ring has one producer and one consumer thread: one raw ring per camera
+// (capture -> stream), one processed and one embeddings ring per inference worker
+// (worker -> stream, worker -> identification)
+static constexpr size_t FRAME_RING_SIZE = 10;
+
+// consumers sleep on these until a ring they read gets an entry, the timeout only bounds how long
+// a shutdown or a state change takes to be noticed
+static RingNotifier stream_notifier;   // raw, processed and identify rings
+static RingNotifier identify_notifier; // embeddings rings
+static constexpr std::chrono::milliseconds WAKE_UP_TIMEOUT(100);
+
+// a camera that fails to open or to deliver a frame is retried after this, the others keep running
+static constexpr std::chrono::seconds CAMERA_RETRY_DELAY(1);
 
 
 
@@ -22,17 +40,29 @@ static std::mutex processed_frame_queue_mutex;
 bool parseCommandLineArgs(int argc, char *argv[], std::string &app_name, std::string &config_file,
                           std::string &database_file, std::string &websocket_host, unsigned short &websocket_port);
 
-bool loadConfig(CameraConfig &camera_config, ModelsConfig &models_config, const std::string &filename, const Logging& logger);
+bool loadConfig(CameraConfig &camera_config, ModelsConfig &models_config, DatabaseConfig &database_config,
+                const std::string &filename, const Logging& logger);
 bool createCamera(const CameraConfig &camera_config, std::unique_ptr<Camera> &camera, const Logging& logger);
-bool loadDatabase(const std::string &filename, EmbeddingDB<People> &embedding_db, const Logging& logger);
-
-void cameraCaptureThread(const CameraConfig& config, cv::Mat &frame, std::atomic<bool> &is_capture,
-                        std::atomic<bool> &running, std::condition_variable &capture_cv, const Logging& logger,
-                        std::mutex& frame_mutex, std::atomic<bool>& frame_ready);
-
-void processFrameThread(const ModelsConfig& models_config, cv::Mat &frame, std::atomic<bool>& is_process,
-                        std::atomic<bool> &running, std::condition_variable &capture_cv, const Logging& logger,
-                        std::mutex& frame_mutex, std::atomic<bool>& frame_ready);
+bool loadDatabase(const std::string &filename, EmbeddingDB<People> &embedding_db, bool verify_checksum,
+                  const Logging& logger);
+void enrollPerson(EmbeddingDB<People> &embedding_db, People person, std::vector<std::vector<float>> capture_embeddings,
+                  uint64_t journal_checkpoint_bytes, const Logging& logger);
+
+void cameraCaptureThread(size_t camera_id, const CameraConfig& config, SpscRing<FramePool::Frame>& frame_ring,
+                         WorkStealingQueue& frame_queue, std::atomic<bool> &is_capture, std::atomic<bool> &running,
+                         const Logging& logger);
+
+void processFrameThread(size_t worker_id, const ModelsConfig& models_config, WorkStealingQueue& frame_queue,
+                        SpscRing<CameraFrame>& processed_frame_ring, SpscRing<CameraEmbeddings>& embeddings_ring,
+                        std::atomic<bool>& is_process, std::atomic<bool> &running, const Logging& logger);
+void processFrame(const cv::Mat& frame, MTCNNDetector& detector, FaceEmbedding& face_embedding,
+                  std::vector<std::vector<float>>& embeddings, std::shared_ptr<cv::Mat>& draw_frame);
+
+template <typename T>
+void logRing(const Logging& logger, const std::string& name, const SpscRing<T>& ring) {
+    logger.log(Logging::LogStatus::INFO, name + " ring: " + std::to_string(ring.pushed()) + " pushed, " +
+               std::to_string(ring.dropped()) + " dropped, " + std::to_string(ring.depth()) + " waiting.");
+}
 
 
 
@@ -66,55 +96,93 @@ int main(int argc, char *argv[]) {
     // Load camera configuration
     CameraConfig camera_config;
     ModelsConfig models_config;
-    if (!loadConfig(camera_config, models_config, config_file, logger)) return 1;
-    logger.log(Logging::LogStatus::INFO, "Camera and Models configuration loaded successfully.");
+    DatabaseConfig database_config;
+    if (!loadConfig(camera_config, models_config, database_config, config_file, logger)) return 1;
+    logger.log(Logging::LogStatus::INFO, "Camera, Models and Database configuration loaded successfully.");
     logger.log(Logging::LogStatus::INFO, camera_config.toJson());
     logger.log(Logging::LogStatus::INFO, models_config.toJson());
+    logger.log(Logging::LogStatus::INFO, database_config.toJson());
 
     // Create or load embedding database
     EmbeddingDB<People> embedding_db(FaceEmbedding::EMBEDDING_SIZE);
+    if (database_config.index_type() == DatabaseConfig::IndexType::HNSW) {
+        HNSWIndex::Params hnsw_params;
+        hnsw_params.M = database_config.hnsw_m();
+        hnsw_params.ef_construction = database_config.hnsw_ef_construction();
+        hnsw_params.ef_search = database_config.hnsw_ef_search();
+        embedding_db.enable_hnsw(hnsw_params);
+    }
+    if (database_config.quantization() != DatabaseConfig::Quantization::NONE) {
+        QuantizedRows::Mode mode = database_config.quantization() == DatabaseConfig::Quantization::INT8
+                                       ? QuantizedRows::Mode::INT8 : QuantizedRows::Mode::FP16;
+        embedding_db.enable_quantization(mode, database_config.rerank_candidates());
+    }
+    if (database_config.scan_threads() != 1) {
+        embedding_db.enable_parallel_scan(database_config.scan_threads(), database_config.parallel_scan_min_rows());
+    }
     if (!database_file.empty()) {
-        if (!loadDatabase(database_file, embedding_db, logger)) {
+        if (!loadDatabase(database_file, embedding_db, database_config.verify_checksum(), logger)) {
             logger.log(Logging::LogStatus::INFO, "Using empty database.");
         }
+        // Enrollments are appended to <database>.wal instead of rewriting the database file
+        try {
+            if (embedding_db.enable_journal(database_file, database_config.journal_sync_every())) {
+                logger.log(Logging::LogStatus::INFO, "Database journal opened: " + database_file + ".wal");
+            } else {
+                logger.log(Logging::LogStatus::WARNING, "Failed to open the database journal, changes are saved on exit only.");
+            }
+        } catch (const std::exception& e) {
+            logger.log(Logging::LogStatus::ERROR, "Error opening database journal: " + std::string(e.what()));
+        }
     }
+    const uint64_t journal_checkpoint_bytes = static_cast<uint64_t>(database_config.journal_checkpoint_mb()) << 20;
 
 
     std::atomic<bool> running(true);
 
+    const size_t camera_count = camera_config.camera_count();
+    const size_t worker_count = static_cast<size_t>(models_config.inference_workers());
+    logger.log(Logging::LogStatus::INFO, std::to_string(camera_count) + " camera(s), " +
+               std::to_string(worker_count) + " inference worker(s).");
+
+    RingSet<FramePool::Frame> frame_rings = makeRingSet<FramePool::Frame>(camera_count, FRAME_RING_SIZE, &stream_notifier);
+    RingSet<CameraFrame> processed_frame_rings = makeRingSet<CameraFrame>(worker_count, FRAME_RING_SIZE, &stream_notifier);
+    RingSet<CameraEmbeddings> embeddings_rings = makeRingSet<CameraEmbeddings>(worker_count, FRAME_RING_SIZE, &identify_notifier);
+    // a camera keeps at most one frame per worker waiting, enough to keep every worker busy
+    WorkStealingQueue frame_queue(camera_count, worker_count, worker_count);
+
 
     try{
-        // Start camera capture thread
-        cv::Mat frame;
-        std::mutex frame_mutex;
+        // Start one capture thread per camera
         std::atomic<bool> is_capture(false);
-        std::atomic<bool> frame_ready(false);
-        std::condition_variable capture_cv;
+        std::vector<std::thread> capture_threads;
+        for (size_t i = 0; i < camera_count; ++i) {
+            capture_threads.emplace_back(
+                cameraCaptureThread, i, camera_config.camera(i), std::ref(*frame_rings[i]), std::ref(frame_queue),
+                std::ref(is_capture), std::ref(running), std::ref(logger)
+            );
+        }
 
-        std::thread capture_thread(
-            cameraCaptureThread, std::ref(camera_config), std::ref(frame), std::ref(is_capture),
-            std::ref(running), std::ref(capture_cv), std::ref(logger), std::ref(frame_mutex), std::ref(frame_ready)
-        );
-        
-         // Start process thread
+        // Start the inference workers, shared by every camera
         std::atomic<bool> is_process(false);
-        std::atomic<bool> is_add_embedding(false);
-        
-        std::thread process_thread(
-            processFrameThread, std::ref(models_config), std::ref(frame), std::ref(is_process),
-            std::ref(running), std::ref(capture_cv), std::ref(logger), std::ref(frame_mutex), std::ref(frame_ready)
-        );
+        std::vector<std::thread> process_threads;
+        for (size_t i = 0; i < worker_count; ++i) {
+            process_threads.emplace_back(
+                processFrameThread, i, std::ref(models_config), std::ref(frame_queue), std::ref(*processed_frame_rings[i]),
+                std::ref(*embeddings_rings[i]), std::ref(is_process), std::ref(running), std::ref(logger)
+            );
+        }
 
         // Start stream server
-        std::queue<People> identify_queue;
-        std::mutex identify_mutex;
+        SpscRing<Identification> identify_ring(32);
+        identify_ring.set_notifier(&stream_notifier);
         std::unique_ptr<People> new_person_ptr = nullptr;
         std::mutex new_person_mutex;
 
         std::thread stream_thread(
-            websocketServerThread, std::ref(running), std::ref(is_capture), std::ref(is_process), 
-            std::ref(frame_queue_mutex), std::ref(frame_queue), std::ref(processed_frame_queue_mutex), std::ref(processed_frame_queue), 
-            std::ref(identify_mutex), std::ref(identify_queue), std::ref(new_person_ptr), std::ref(new_person_mutex),
+            websocketServerThread, std::ref(running), std::ref(is_capture), std::ref(is_process), std::ref(frame_queue),
+            std::ref(frame_rings), std::ref(processed_frame_rings), std::ref(identify_ring), std::ref(stream_notifier),
+            std::ref(new_person_ptr), std::ref(new_person_mutex),
             std::ref(logger), std::ref(websocket_host), websocket_port
         );
 
@@ -123,42 +191,82 @@ int main(int argc, char *argv[]) {
         std::signal(SIGINT, handle_signal);
         std::signal(SIGTERM, handle_signal);
 
-        
+
+        // Enrollment capture runs inside the identification loop, the insert runs on its own thread
+        std::thread enrollment_thread;
+        std::unique_ptr<People> capture_person = nullptr;
+        std::vector<std::vector<float>> capture_embeddings;
+        std::chrono::steady_clock::time_point capture_start;
+        // the enrollment takes its embeddings from one camera only, the first to see a single face
+        constexpr size_t NO_CAMERA = static_cast<size_t>(-1);
+        size_t capture_camera = NO_CAMERA;
+        CameraEmbeddings embeddings;
+        // the workers finish frames in any order, identification takes them back in capture order
+        std::vector<ReorderBuffer<CameraEmbeddings>> reorder_buffers(camera_count);
+
         while (running) {
             try {
-                if (is_capture && is_process && !processed_frame_queue.empty() && embedding_db.size() > 0 && new_person_ptr == nullptr) {
-                    std::vector<std::vector<float>> embeddings;
-                    {
-                        std::lock_guard<std::mutex> lock(processed_frame_queue_mutex);
-                        if (!processed_frame_queue.empty()) {
-                            embeddings = processed_frame_queue.front().second; 
-                            processed_frame_queue.pop();
+                if (is_capture && is_process && capture_person == nullptr) {
+                    std::lock_guard<std::mutex> lock(new_person_mutex);
+                    if (new_person_ptr != nullptr) {
+                        capture_person = std::make_unique<People>(*new_person_ptr);
+                        capture_embeddings.clear();
+                        capture_camera = NO_CAMERA;
+                        // skip the frames processed before the person faced the camera
+                        capture_start = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+                    }
+                }
+
+                // popped even while paused, so a stale entry never keeps the wait below from sleeping
+                const bool identifying = is_capture && is_process;
+                for (auto& embeddings_ring : embeddings_rings) {
+                    while (embeddings_ring->pop(embeddings)) {
+                        if (identifying) {
+                            reorder_buffers[embeddings.camera].push(embeddings.seq, std::move(embeddings));
                         }
                     }
-                    
-                    if (!embeddings.empty()) {
+                }
+                if (!identifying) {
+                    for (auto& reorder_buffer : reorder_buffers) reorder_buffer.reset();
+                }
+
+                for (auto& reorder_buffer : reorder_buffers) {
+                    while (reorder_buffer.pop(embeddings)) {
+                        if (embeddings.values.empty()) continue;
+
                         bool valid_embeddings = true;
-                        for (const auto& embedding : embeddings) {
+                        for (const auto& embedding : embeddings.values) {
                             if (embedding.size() != FaceEmbedding::EMBEDDING_SIZE) {
                                 valid_embeddings = false;
                                 break;
                             }
                         }
-                        
-                        if (valid_embeddings) {
+
+                        if (valid_embeddings && capture_person != nullptr && embeddings.values.size() == 1 &&
+                            std::chrono::steady_clock::now() >= capture_start) {
+                            if (capture_camera == NO_CAMERA) capture_camera = embeddings.camera;
+                            if (capture_camera == embeddings.camera) capture_embeddings.push_back(embeddings.values[0]);
+                        }
+
+                        // one snapshot for the query and the info lookup, enrollments never shift its indices
+                        auto db_snapshot = embedding_db.snapshot();
+                        if (valid_embeddings && db_snapshot->size() > 0) {
                             double min_distance = 2.0;
                             People nearest_person;
-                            for (const auto& embedding : embeddings) {
-                                auto query_result = embedding_db.query_nearest(embedding);
+                            Eigen::MatrixXf queries = convert_embeddings_to_matrix(embeddings.values, FaceEmbedding::EMBEDDING_SIZE);
+                            for (const auto& query_result : db_snapshot->query_nearest_batch(queries)) {
                                 if (query_result.second < min_distance) {
                                     min_distance = query_result.second;
-                                    nearest_person = embedding_db.info(query_result.first);
+                                    nearest_person = db_snapshot->info(query_result.first);
                                 }
                             }
 
                             if (min_distance < 0.4) {
-                                std::lock_guard<std::mutex> lock(identify_mutex);
-                                identify_queue.push(People(nearest_person));
+                                const size_t camera = embeddings.camera;
+                                identify_ring.push([camera, &nearest_person](Identification& slot) {
+                                    slot.camera = camera;
+                                    slot.person = nearest_person;
+                                });
                             }
                         }
                     }
@@ -166,80 +274,53 @@ int main(int argc, char *argv[]) {
             } catch (const std::exception& e) {
                 logger.log(Logging::LogStatus::ERROR, "Error in main loop: " + std::string(e.what()));
             }
-            
-            if (is_capture && is_process && new_person_ptr != nullptr) {
-                std::lock_guard<std::mutex> lock(new_person_mutex);
-                
-                std::vector<std::vector<float>> capture_embeddings;
-
-                // wait for processed frames by sleeping
-                std::this_thread::sleep_for(std::chrono::seconds(1));
 
-                unsigned int frame_count = 0; 
-                
-                while (frame_count < 300){
-                    if (processed_frame_queue.empty()) {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(33));
-                        continue;
-                    }
-                    std::vector<std::vector<float>> embeddings;
-                    {
-                        std::lock_guard<std::mutex> lock(processed_frame_queue_mutex);
-                        if (!processed_frame_queue.empty()) {  // Double check
-                            embeddings = processed_frame_queue.front().second;
-                            processed_frame_queue.pop();
-                        }
-                    }
-                    if (embeddings.empty() || embeddings.size() > 1) continue;
-                    capture_embeddings.push_back(embeddings[0]);
-                    frame_count++;
-                }
-                
-                if (!capture_embeddings.empty()) { 
-                    // generate new ID
-                    int new_id = embedding_db.size() + 1;
-                    new_person_ptr->setId(new_id);
-
-                    // convert embeddings to Eigen matrix
-                    Eigen::MatrixXf capture_embeddings_matrix = convert_embeddings_to_matrix(capture_embeddings, FaceEmbedding::EMBEDDING_SIZE);
-                    // compute mean embeddings
-                    Eigen::VectorXf mean_embedding = capture_embeddings_matrix.colwise().mean();
-                    // normalize mean embedding 
-                    mean_embedding.normalize();
-                    // insert into database
-                    if (embedding_db.insert(mean_embedding.transpose(), *new_person_ptr)) {
-                        logger.log(Logging::LogStatus::INFO, "Inserted new person into the database: " + new_person_ptr->toJsonString());
-
-                        // save database
-                        
-                        if (!database_file.empty() && embedding_db.size() > 0) {
-                            try {
-                                if (embedding_db.store(database_file)) {
-                                    logger.log(Logging::LogStatus::INFO, "Database saved successfully.");
-                                } else {
-                                    logger.log(Logging::LogStatus::WARNING, "Failed to save database.");
-                                }
-                            } catch (const std::exception& e) {
-                                logger.log(Logging::LogStatus::ERROR, "Error saving database: " + std::string(e.what()));
-                            }
-                        }
+            if (capture_person != nullptr && capture_embeddings.size() >= 300) {
+                if (enrollment_thread.joinable()) enrollment_thread.join();
+                logger.log(Logging::LogStatus::INFO, "Enrollment captured from camera " + std::to_string(capture_camera) + ".");
+                enrollment_thread = std::thread(
+                    enrollPerson, std::ref(embedding_db), *capture_person, std::move(capture_embeddings),
+                    journal_checkpoint_bytes, std::ref(logger)
+                );
+                capture_embeddings.clear();
+                capture_person.reset();
+                capture_camera = NO_CAMERA;
 
-                    } else {
-                        logger.log(Logging::LogStatus::ERROR, "Failed to insert new person into the database.");
-                    }
-                }
+                std::lock_guard<std::mutex> lock(new_person_mutex);
                 new_person_ptr.reset();
             }
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            // sleep until the next embeddings arrive
+            identify_notifier.wait_for(WAKE_UP_TIMEOUT, [&running, &embeddings_rings] {
+                return anyPending(embeddings_rings) || !running.load();
+            });
         }
 
-        capture_thread.join();
-        logger.log(Logging::LogStatus::INFO, "Camera capture thread joined successfully.");
-        process_thread.join();
-        logger.log(Logging::LogStatus::INFO, "Frame processing thread joined successfully.");
+        if (enrollment_thread.joinable()) enrollment_thread.join();
+        for (std::thread& capture_thread : capture_threads) capture_thread.join();
+        logger.log(Logging::LogStatus::INFO, "Camera capture threads joined successfully.");
+        frame_queue.stop();
+        for (std::thread& process_thread : process_threads) process_thread.join();
+        logger.log(Logging::LogStatus::INFO, "Frame processing threads joined successfully.");
         stream_thread.join();
         logger.log(Logging::LogStatus::INFO, "WebSocket stream thread joined successfully.");
+
+        for (size_t i = 0; i < camera_count; ++i) {
+            const std::string camera = "Camera " + std::to_string(i);
+            logRing(logger, camera + " raw frame", *frame_rings[i]);
+            logger.log(Logging::LogStatus::INFO, camera + ": " + std::to_string(frame_queue.submitted(i)) + " frames submitted, " +
+                       std::to_string(frame_queue.taken(i)) + " processed, " + std::to_string(frame_queue.dropped(i)) + " skipped, " +
+                       std::to_string(reorder_buffers[i].skipped()) + " results lost, " +
+                       std::to_string(reorder_buffers[i].late()) + " late.");
+        }
+        logger.log(Logging::LogStatus::INFO, "Frames stolen between workers: " + std::to_string(frame_queue.stolen()) + ".");
+        for (size_t i = 0; i < worker_count; ++i) {
+            const std::string worker = "Worker " + std::to_string(i);
+            logRing(logger, worker + " processed frame", *processed_frame_rings[i]);
+            logRing(logger, worker + " embeddings", *embeddings_rings[i]);
+        }
+        logRing(logger, "Identify", identify_ring);
+        logger.log(Logging::LogStatus::INFO, "Frame pool: " + std::to_string(frame_pool.allocated()) + " buffers allocated.");
         
     }
     catch(const std::exception& e){
@@ -318,10 +399,12 @@ bool parseCommandLineArgs(int argc, char *argv[], std::string &app_name, std::st
 }
 
 
-bool loadConfig(CameraConfig &camera_config, ModelsConfig &models_config, const std::string &filename, const Logging& logger) {
+bool loadConfig(CameraConfig &camera_config, ModelsConfig &models_config, DatabaseConfig &database_config,
+                const std::string &filename, const Logging& logger) {
     try {
         camera_config.load(filename);
         models_config.load(filename);
+        database_config.load(filename);
     } catch (const std::exception &e) {
         logger.log(Logging::LogStatus::ERROR, e.what());
         return false;
@@ -348,9 +431,10 @@ bool createCamera(const CameraConfig &camera_config, std::unique_ptr<Camera> &ca
 }
 
 
-bool loadDatabase(const std::string &filename, EmbeddingDB<People> &embedding_db, const Logging& logger) {
+bool loadDatabase(const std::string &filename, EmbeddingDB<People> &embedding_db, bool verify_checksum,
+                  const Logging& logger) {
     try {
-        if (!embedding_db.load(filename)) {
+        if (!embedding_db.load(filename, verify_checksum)) {
             logger.log(Logging::LogStatus::WARNING, "Failed to load the database " + filename);
             return false;
         }
@@ -362,29 +446,68 @@ bool loadDatabase(const std::string &filename, EmbeddingDB<People> &embedding_db
 }
 
 
-void cameraCaptureThread(const CameraConfig& config, cv::Mat &frame, std::atomic<bool> &is_capture,
-                        std::atomic<bool> &running, std::condition_variable &capture_cv, const Logging& logger,
-                        std::mutex& frame_mutex, std::atomic<bool>& frame_ready) {    
+void enrollPerson(EmbeddingDB<People> &embedding_db, People person, std::vector<std::vector<float>> capture_embeddings,
+                  uint64_t journal_checkpoint_bytes, const Logging& logger) {
+    // generate new ID
+    int new_id = embedding_db.size() + 1;
+    person.setId(new_id);
+
+    // convert embeddings to Eigen matrix
+    Eigen::MatrixXf capture_embeddings_matrix = convert_embeddings_to_matrix(capture_embeddings, FaceEmbedding::EMBEDDING_SIZE);
+    // compute mean embeddings
+    Eigen::VectorXf mean_embedding = capture_embeddings_matrix.colwise().mean();
+    // normalize mean embedding 
+    mean_embedding.normalize();
+    // insert into database, the journal makes the enrollment durable
+    bool inserted = false;
+    try {
+        inserted = embedding_db.insert(mean_embedding.transpose(), person);
+    } catch (const std::exception& e) {
+        // the journal is written first, a failed write leaves the person out of the database
+        logger.log(Logging::LogStatus::ERROR, "Error writing database journal: " + std::string(e.what()));
+        inserted = false;
+    }
+    if (!inserted) {
+        logger.log(Logging::LogStatus::ERROR, "Failed to insert new person into the database.");
+        return;
+    }
+    logger.log(Logging::LogStatus::INFO, "Inserted new person into the database: " + person.toJsonString());
 
-    logger.log(Logging::LogStatus::INFO, "Camera capture thread started.");
+    // fold the journal into the database file once it grows large
+    if (embedding_db.journal_bytes() > journal_checkpoint_bytes) {
+        try {
+            if (embedding_db.checkpoint()) {
+                logger.log(Logging::LogStatus::INFO, "Database saved successfully.");
+            } else {
+                logger.log(Logging::LogStatus::WARNING, "Failed to save database.");
+            }
+        } catch (const std::exception& e) {
+            logger.log(Logging::LogStatus::ERROR, "Error saving database: " + std::string(e.what()));
+        }
+    }
+}
+
+
+void cameraCaptureThread(size_t camera_id, const CameraConfig& config, SpscRing<FramePool::Frame>& frame_ring,
+                         WorkStealingQueue& frame_queue, std::atomic<bool> &is_capture, std::atomic<bool> &running,
+                         const Logging& logger) {
+
+    const std::string name = "Camera " + std::to_string(camera_id);
+    logger.log(Logging::LogStatus::INFO, name + " capture thread started.");
     std::unique_ptr<Camera> camera = nullptr;
-    const size_t MAX_QUEUE_SIZE = 10; 
+    // read() already blocks until the camera delivers the next frame, this only caps the rate
+    FramePacer pacer(config.max_fps());
 
     while (running) {
         if (!is_capture) {
             if (camera) {
                 camera->release();
                 camera.reset();
-                logger.log(Logging::LogStatus::INFO, "Camera released.");
+                logger.log(Logging::LogStatus::INFO, name + " released.");
             }
 
-            // free the frame queue
-            {
-                std::lock_guard<std::mutex> lock(frame_queue_mutex);
-                while (!frame_queue.empty()) {
-                    frame_queue.pop();
-                }
-            }
+            // free the frame ring
+            frame_ring.clear();
 
             std::this_thread::sleep_for(std::chrono::seconds(1));
             continue;
@@ -393,126 +516,115 @@ void cameraCaptureThread(const CameraConfig& config, cv::Mat &frame, std::atomic
         // Create camera instance
         if (!camera) {
             if (!createCamera(config, camera, logger)) {
-                logger.log(Logging::LogStatus::ERROR, "Failed to open camera.");
-                is_capture = false;
+                logger.log(Logging::LogStatus::ERROR, "Failed to open " + name + ", retrying.");
+                camera.reset();
+                std::this_thread::sleep_for(CAMERA_RETRY_DELAY);
                 continue;
             }
-            logger.log(Logging::LogStatus::INFO, "Camera opened successfully.");
+            logger.log(Logging::LogStatus::INFO, name + " opened successfully.");
         }
 
-        // Capture frame
-        cv::Mat temp_frame;
-        if (camera->read(temp_frame)) {
-            {
-                std::lock_guard<std::mutex> lock(frame_queue_mutex);
-                if (frame_queue.size() >= MAX_QUEUE_SIZE) {
-                    frame_queue.pop();
-                }
-                frame_queue.push(temp_frame.clone());
-            }
-            {
-                std::lock_guard<std::mutex> lock(frame_mutex);
-                frame = temp_frame.clone();
-                frame_ready = true;
-            }
-            capture_cv.notify_one();
+        // Capture into a pooled buffer, the stream and the inference workers share it read-only
+        std::shared_ptr<cv::Mat> buffer = frame_pool.acquire();
+        if (camera->read(*buffer)) {
+            FramePool::Frame captured = std::move(buffer);
+            frame_ring.push([&captured](FramePool::Frame& slot) { slot = captured; });
+            frame_queue.submit(camera_id, std::move(captured));
 
         } else {
-            logger.log(Logging::LogStatus::WARNING, "Failed to read frame from camera.");
-            {
-                std::lock_guard<std::mutex> lock(frame_mutex);
-                frame_ready = false;
-            }
-            is_capture = false;
+            // only this camera stops, it is reopened after the retry delay
+            logger.log(Logging::LogStatus::WARNING, "Failed to read frame from " + name + ", reopening.");
+            camera->release();
+            camera.reset();
+            std::this_thread::sleep_for(CAMERA_RETRY_DELAY);
+            continue;
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(33)); // ~30 FPS
+        pacer.wait();
     }
 }
 
 
-void processFrameThread(const ModelsConfig& models_config, cv::Mat &frame, std::atomic<bool>& is_process,
-                        std::atomic<bool> &running, std::condition_variable &capture_cv, const Logging& logger,
-                        std::mutex& frame_mutex, std::atomic<bool>& frame_ready) {
-                            
-    logger.log(Logging::LogStatus::INFO, "Frame processing thread started.");
-    
+void processFrameThread(size_t worker_id, const ModelsConfig& models_config, WorkStealingQueue& frame_queue,
+                        SpscRing<CameraFrame>& processed_frame_ring, SpscRing<CameraEmbeddings>& embeddings_ring,
+                        std::atomic<bool>& is_process, std::atomic<bool> &running, const Logging& logger) {
+
+    const std::string name = "Worker " + std::to_string(worker_id);
+    logger.log(Logging::LogStatus::INFO, name + " frame processing thread started.");
+
     try {
+        // every worker owns its models, a camera gets whichever worker is free
         MTCNNDetector detector(models_config);
         FaceEmbedding face_embedding(models_config);
-        logger.log(Logging::LogStatus::INFO, "Detector and Face Embedding instances created successfully.");
-
-        const size_t MAX_QUEUE_SIZE = 10; 
+        logger.log(Logging::LogStatus::INFO, name + " detector and Face Embedding instances created successfully.");
 
         while (running) {
             if (!is_process) {
-                {
-                    std::lock_guard<std::mutex> lock(processed_frame_queue_mutex);
-                    while (!processed_frame_queue.empty()) {
-                        processed_frame_queue.pop();
-                    }
-                }
+                processed_frame_ring.clear();
+                embeddings_ring.clear();
                 std::this_thread::sleep_for(std::chrono::seconds(1));
                 continue;
             }
-            
-            cv::Mat temp_frame;
-            
-            {
-                std::unique_lock<std::mutex> lock(frame_mutex);
-                capture_cv.wait(lock, [&frame_ready, &running] { return frame_ready.load() || !running.load(); });
-                if (!running) break;
-                
-                if (frame.empty()) {
-                    frame_ready = false;
-                    continue;
-                }
-                temp_frame = frame.clone();
-                frame_ready = false;
-            }
 
-            if (temp_frame.empty()) continue;
+            // keeps the captured buffer alive while this thread reads it
+            FrameJob job;
+            if (!frame_queue.next(worker_id, job, WAKE_UP_TIMEOUT)) continue;
 
+            std::vector<std::vector<float>> embeddings;
+            std::shared_ptr<cv::Mat> draw_frame;
             try {
-                std::vector<Face> faces = detector.detect(temp_frame, 20, 0.709f);
-                if (faces.empty()) continue;
-                
-                bool valid_faces = true;
-                for (const auto& face : faces) {
-                    cv::Rect rect = face.bbox.getRect();
-                    if (rect.x < 0 || rect.y < 0 || 
-                        rect.x + rect.width > temp_frame.cols || 
-                        rect.y + rect.height > temp_frame.rows ||
-                        rect.width <= 0 || rect.height <= 0) {
-                        valid_faces = false;
-                        break;
-                    }
-                }
-                
-                if (!valid_faces) continue;
-                
-                std::vector<std::vector<float>> embeddings = face_embedding.embeddings(temp_frame, faces);
-                if (embeddings.empty()) continue;
-
-                cv::Mat draw_frame = getDrawFacesImage(temp_frame, faces);
-                
-                {
-                    std::lock_guard<std::mutex> lock(processed_frame_queue_mutex);
-                    if (processed_frame_queue.size() >= MAX_QUEUE_SIZE) {
-                        processed_frame_queue.pop();
-                    }
-                    processed_frame_queue.push({draw_frame.clone(), embeddings});
-                }
+                processFrame(*job.frame, detector, face_embedding, embeddings, draw_frame);
             }
             catch(const std::exception& e){
-                logger.log(Logging::LogStatus::WARNING, "Error in face processing: " + std::string(e.what()));
+                logger.log(Logging::LogStatus::WARNING, name + " error in face processing: " + std::string(e.what()));
+                embeddings.clear();
+                draw_frame.reset();
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(33));
+            job.frame.reset();
+
+            // every frame taken gets its results pushed, empty when no face was found, so the
+            // consumers never wait for a sequence number that is not coming
+            processed_frame_ring.push([&job, &draw_frame](CameraFrame& slot) {
+                slot.camera = job.camera;
+                slot.seq = job.seq;
+                slot.frame = std::move(draw_frame);
+            });
+            embeddings_ring.push([&job, &embeddings](CameraEmbeddings& slot) {
+                slot.camera = job.camera;
+                slot.seq = job.seq;
+                slot.values.swap(embeddings);
+            });
         }
     } catch (const std::exception &e) {
         logger.log(Logging::LogStatus::ERROR, "Fatal error in processFrameThread: " + std::string(e.what()));
         running = false;
     }
-    
+
+}
+
+
+void processFrame(const cv::Mat& frame, MTCNNDetector& detector, FaceEmbedding& face_embedding,
+                  std::vector<std::vector<float>>& embeddings, std::shared_ptr<cv::Mat>& draw_frame) {
+    if (frame.empty()) return;
+
+    std::vector<Face> faces = detector.detect(frame, 20, 0.709f);
+    if (faces.empty()) return;
+
+    for (const auto& face : faces) {
+        cv::Rect rect = face.bbox.getRect();
+        if (rect.x < 0 || rect.y < 0 ||
+            rect.x + rect.width > frame.cols ||
+            rect.y + rect.height > frame.rows ||
+            rect.width <= 0 || rect.height <= 0) {
+            return;
+        }
+    }
+
+    embeddings = face_embedding.embeddings(frame, faces);
+    if (embeddings.empty()) return;
+
+    // the one copy of the frame, into a pooled buffer
+    draw_frame = frame_pool.acquire();
+    getDrawFacesImage(frame, faces, *draw_frame);
 }
 
 
@@ -0,0 +1,66 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "People.hpp"
+#include "frame_pool.hpp"
+#include "spsc_ring.hpp"
+
+
+/*
+    * Entries moved between the pipeline threads, tagged with the index of the camera they come
+    * from (the order of the cameras in the config, 0 being source / rtsp_url). The inference
+    * workers finish frames in any order, their results also carry the sequence number of the
+    * frame so the consumers can restore the capture order.
+*/
+
+// Frame with the detected faces drawn, inference worker -> stream
+struct CameraFrame {
+    size_t camera = 0;
+    uint64_t seq = 0;       // of the captured frame, see WorkStealingQueue
+    FramePool::Frame frame; // null when no face was found
+};
+
+// Embeddings of the faces found in one frame, inference worker -> identification
+struct CameraEmbeddings {
+    size_t camera = 0;
+    uint64_t seq = 0;
+    std::vector<std::vector<float>> values; // empty when no face was found
+};
+
+// Person recognized in a frame, identification -> stream
+struct Identification {
+    size_t camera = 0;
+    People person;
+};
+
+
+// One ring per producer thread, a consumer reading several producers walks the whole set
+template <typename T>
+using RingSet = std::vector<std::unique_ptr<SpscRing<T>>>;
+
+template <typename T>
+RingSet<T> makeRingSet(size_t count, size_t capacity, RingNotifier* notifier) {
+    RingSet<T> rings;
+    rings.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        rings.push_back(std::make_unique<SpscRing<T>>(capacity));
+        rings.back()->set_notifier(notifier);
+    }
+    return rings;
+}
+
+template <typename T>
+bool anyPending(const RingSet<T>& rings) {
+    for (const auto& ring : rings) {
+        if (!ring->empty()) return true;
+    }
+    return false;
+}
+
+
+#endif // PIPELINE_HPP
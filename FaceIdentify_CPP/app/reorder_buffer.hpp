@@ -0,0 +1,78 @@
+#ifndef REORDER_BUFFER_HPP
+#define REORDER_BUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <utility>
+
+
+/*
+    * Puts the results of one camera back in sequence order, as they come out of several inference
+    * workers finishing in any order.
+    *
+    * push() holds a result until every result before it was released, pop() releases them in
+    * order. A result lost on the way (a full ring drops its oldest entry) would hold back every
+    * later one, so once window results wait behind a missing sequence number it is skipped, and a
+    * result that shows up after being skipped is discarded as late. Not thread safe, the buffer
+    * belongs to the consumer thread.
+*/
+template <typename T>
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(size_t window = 16) : window_(window) {}
+
+    // Hold value for sequence number seq, false when it comes too late to be released in order
+    bool push(uint64_t seq, T value) {
+        if (!synced_) {
+            // first result after a reset, the sequence continues from here
+            next_ = seq;
+            synced_ = true;
+        }
+        if (seq < next_) {
+            ++late_;
+            return false;
+        }
+        waiting_[seq] = std::move(value);
+        return true;
+    }
+
+    // Next result in sequence order, false while it has not arrived yet
+    bool pop(T& out) {
+        if (waiting_.empty()) return false;
+
+        auto it = waiting_.begin();
+        if (it->first != next_) {
+            if (waiting_.size() < window_) return false;
+            // give up on the missing results
+            skipped_ += it->first - next_;
+        }
+        out = std::move(it->second);
+        next_ = it->first + 1;
+        waiting_.erase(it);
+        return true;
+    }
+
+    // Drop the waiting results and start over from the next sequence number pushed
+    void reset() {
+        waiting_.clear();
+        synced_ = false;
+    }
+
+    size_t waiting() const { return waiting_.size(); }
+
+    // Sequence numbers given up on, and results discarded because they came after that
+    uint64_t skipped() const { return skipped_; }
+    uint64_t late() const { return late_; }
+
+private:
+    const size_t window_;
+    std::map<uint64_t, T> waiting_;
+    uint64_t next_ = 0;
+    bool synced_ = false;
+    uint64_t skipped_ = 0;
+    uint64_t late_ = 0;
+};
+
+
+#endif // REORDER_BUFFER_HPP
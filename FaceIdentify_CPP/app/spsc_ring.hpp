@@ -0,0 +1,167 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+
+/*
+    * Wakes a consumer thread that waits for entries in one or more rings, instead of polling them.
+    * Only the wake-up takes the mutex, the entries themselves still move lock-free.
+*/
+class RingNotifier {
+public:
+    void notify() {
+        // a waiter between its ready() check and its wait still holds the mutex
+        { std::lock_guard<std::mutex> lock(mutex_); }
+        cv_.notify_all();
+    }
+
+    // Wait until ready() holds or timeout passes, the result of ready()
+    template <typename Rep, typename Period, typename Ready>
+    bool wait_for(const std::chrono::duration<Rep, Period>& timeout, Ready ready) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cv_.wait_for(lock, timeout, ready);
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+
+/*
+    * Bounded lock-free hand-off between one producer thread and one consumer thread.
+    *
+    * Slots are allocated once and reused: push() lets the producer write into the next free slot
+    * in place (cv::Mat::copyTo into a slot of the same size does not allocate), pop() swaps the
+    * oldest entry with the consumer's value, so the consumer hands its previous buffer back to the
+    * ring instead of freeing it.
+    *
+    * When the ring is full push() drops the oldest entry (drop-oldest), so a slow consumer always
+    * gets the most recent entries. The producer retires that entry itself, which is why the head
+    * is advanced with a CAS and every slot carries a sequence number (as in Vyukov's bounded
+    * queue): a slot the consumer is still swapping out is never overwritten.
+    *
+    * clear() may be called from either side. With a RingNotifier attached every push() wakes the
+    * consumer waiting on it.
+*/
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : capacity_(capacity), slots_(new Slot[capacity]) {
+        // one slot would read its filled sequence number as free for the next push
+        if (capacity < 2) {
+            throw std::invalid_argument("SpscRing capacity must be at least 2");
+        }
+        for (size_t i = 0; i < capacity; ++i) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Notify notifier on every push, set before the producer starts
+    void set_notifier(RingNotifier* notifier) { notifier_ = notifier; }
+
+    // Producer: fill(T&) writes the new entry into a free slot, which still holds whatever entry
+    // used it before. The oldest entry is dropped when the ring is full.
+    template <typename Fill>
+    void push(Fill&& fill) {
+        const size_t pos = tail_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[pos % capacity_];
+        while (slot.seq.load(std::memory_order_acquire) != pos) {
+            if (pos - head_.load(std::memory_order_acquire) >= capacity_) {
+                // full, the oldest entry lives in this very slot
+                if (take(nullptr)) dropped_.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                // the consumer is swapping the entry out right now
+                std::this_thread::yield();
+            }
+        }
+
+        fill(slot.value);
+        slot.seq.store(pos + 1, std::memory_order_release);
+        tail_.store(pos + 1, std::memory_order_release);
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        if (notifier_) notifier_->notify();
+    }
+
+    // Consumer: swap the oldest entry into out, false when the ring is empty
+    bool pop(T& out) {
+        return take(&out);
+    }
+
+    // Drop every entry, releasing what they hold
+    void clear() {
+        T discarded;
+        while (take(&discarded)) {
+            discarded = T();
+        }
+    }
+
+    // Entries waiting to be popped
+    size_t depth() const {
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        const size_t head = head_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const { return depth() == 0; }
+
+    size_t capacity() const { return capacity_; }
+
+    // Entries pushed, and entries dropped by push() because the ring was full
+    uint64_t pushed() const { return pushed_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<size_t> seq; // pos: free for the push at pos, pos + 1: holds that entry
+        T value;
+    };
+
+    const size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    RingNotifier* notifier_ = nullptr;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<uint64_t> pushed_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    // Retire the oldest entry, swapping it into out unless out is null
+    bool take(T* out) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[pos % capacity_];
+            const size_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq == pos + 1) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    if (out) {
+                        using std::swap;
+                        swap(*out, slot.value);
+                    }
+                    slot.seq.store(pos + capacity_, std::memory_order_release);
+                    return true;
+                }
+            } else if (seq < pos + 1) {
+                return false; // empty
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+
+#endif // SPSC_RING_HPP
@@ -7,7 +7,6 @@
 #include <boost/json.hpp>
 #include <boost/beast/websocket.hpp>
 #include <opencv2/opencv.hpp>
-#include <queue>
 #include <thread>
 #include <mutex>
 #include <atomic>
@@ -17,6 +16,11 @@
 
 #include "loging.hpp"
 #include "People.hpp"
+#include "frame_pool.hpp"
+#include "pipeline.hpp"
+#include "reorder_buffer.hpp"
+#include "spsc_ring.hpp"
+#include "work_stealing_queue.hpp"
 
 
 namespace beast = boost::beast;
@@ -66,17 +70,18 @@ std::string base64_encode(const std::vector<uchar>& buf) {
 /*
     * WebSocket server thread function
     * This function handles incoming WebSocket connections and messages.
-    * It sends raw frames, processed frames, and identification results to the client.
+    * It sends raw frames, processed frames, and identification results to the client, each message
+    * carrying the index of the camera it comes from as "camera".
     *
     * @param running: Atomic boolean to control the running state of the server.
     * @param is_capture: Atomic boolean to control the capture state.
     * @param is_process: Atomic boolean to control the processing state.
-    * @param frame_queue_mutex: Mutex for synchronizing access to the frame queue.
-    * @param frame_queue: Queue for storing raw frames.
-    * @param processed_frame_queue_mutex: Mutex for synchronizing access to the processed frame queue.
-    * @param processed_frame_queue: Queue for storing processed frames and their embeddings.
-    * @param identify_mutex: Mutex for synchronizing access to the identification queue.
-    * @param identify_queue: Queue for storing identification results.
+    * @param frame_queue: Frames waiting for the inference workers, dropped when processing stops.
+    * @param frame_rings: Rings of raw frames, one per camera, this thread is their consumer.
+    * @param processed_frame_rings: Rings of frames with the detected faces drawn, one per inference worker,
+    *                               this thread is their consumer. They are sent in capture order per camera.
+    * @param identify_ring: Ring of identification results, this thread is its consumer.
+    * @param stream_notifier: Notified on every push to these rings, the session sleeps on it.
     * @param new_person_ptr: Pointer to a new person object for identification.
     * @param new_person_mutex: Mutex for synchronizing access to the new person pointer.
     * @param logger: Logger instance for logging messages.
@@ -87,12 +92,11 @@ void websocketServerThread(
     std::atomic<bool>& running,
     std::atomic<bool>& is_capture,
     std::atomic<bool>& is_process,
-    std::mutex& frame_queue_mutex,
-    std::queue<cv::Mat>& frame_queue,
-    std::mutex& processed_frame_queue_mutex,
-    std::queue<std::pair<cv::Mat, std::vector<std::vector<float>>>>& processed_frame_queue,
-    std::mutex& identify_mutex,
-    std::queue<People>& identify_queue,
+    WorkStealingQueue& frame_queue,
+    RingSet<FramePool::Frame>& frame_rings,
+    RingSet<CameraFrame>& processed_frame_rings,
+    SpscRing<Identification>& identify_ring,
+    RingNotifier& stream_notifier,
     std::unique_ptr<People>& new_person_ptr,
     std::mutex& new_person_mutex,
     const Logging& logger,
@@ -140,8 +144,8 @@ void websocketServerThread(
             }
 
             std::thread([
-                            &running, &is_capture, &is_process, &frame_queue_mutex, &frame_queue, &processed_frame_queue_mutex, 
-                            &processed_frame_queue, &identify_mutex, &identify_queue, &new_person_ptr, &new_person_mutex, &logger,
+                            &running, &is_capture, &is_process, &frame_queue, &frame_rings, &processed_frame_rings,
+                            &identify_ring, &stream_notifier, &new_person_ptr, &new_person_mutex, &logger,
                             &capture, &process, &client_connected, &client_cv, &client_mutex
                         ](tcp::socket sock) mutable {
                 try {
@@ -149,13 +153,19 @@ void websocketServerThread(
                     ws.accept();
 
                     bool is_receiving = false;
+                    // popped frames are released once sent, so their buffers go back to the pool
+                    FramePool::Frame frame;
+                    CameraFrame processed_frame;
+                    // the workers finish frames in any order, one buffer per camera puts them back in order
+                    std::vector<ReorderBuffer<CameraFrame>> reorder_buffers(frame_rings.size());
+                    Identification identification;
                     
 
                     while (running) {
                         
                         // Read incoming messages
                         if (!is_receiving)
-                        std::thread([&ws, &running, &logger, &is_capture, &is_process, &capture, &process, &is_receiving,
+                        std::thread([&ws, &running, &logger, &is_capture, &is_process, &frame_queue, &capture, &process, &is_receiving,
                                     &new_person_mutex, &new_person_ptr, &client_connected, &client_cv, &client_mutex]() {
                             beast::flat_buffer buffer;
                             boost::system::error_code ec;
@@ -197,6 +207,8 @@ void websocketServerThread(
                                         if (obj.if_contains("type") && obj["type"].as_string() == "process") {
                                             std::lock_guard<std::mutex> lock(process);
                                             is_process = obj.if_contains("value") && obj["value"].as_bool();
+                                            // the paused workers take no frames, release the ones waiting for them
+                                            if (!is_process) frame_queue.clear();
                                             logger.log(Logging::LogStatus::INFO, is_process ? "Client started processing." : "Client stopped processing.");
                                         }
 
@@ -230,62 +242,64 @@ void websocketServerThread(
                         
                         beast::flat_buffer buffer;
 
-                        // Send raw frame if available
-                        cv::Mat frame;
-                        {
-                            std::lock_guard<std::mutex> lock(frame_queue_mutex);
-                            if (!frame_queue.empty()) {
-                                frame = frame_queue.front().clone();
-                                frame_queue.pop();
-                            }
-                        }
+                        // Send a raw frame of every camera if available
                         std::vector<uchar> buf;
                         std::ostringstream oss;
-                        if (!frame.empty()) {
-                            cv::imencode(".jpg", frame, buf);
-                            std::string img_b64 = base64_encode(buf);
-                            oss << "{\"type\":\"raw\",\"image\":\"" << img_b64 << "\"}";
-                            ws.text(true);
-                            ws.write(net::buffer(oss.str()));
+                        for (size_t camera = 0; camera < frame_rings.size(); ++camera) {
+                            if (frame_rings[camera]->pop(frame) && frame && !frame->empty()) {
+                                buf.clear();
+                                oss.str("");
+                                oss.clear();
+                                cv::imencode(".jpg", *frame, buf);
+                                std::string img_b64 = base64_encode(buf);
+                                oss << "{\"type\":\"raw\",\"camera\":" << camera << ",\"image\":\"" << img_b64 << "\"}";
+                                ws.text(true);
+                                ws.write(net::buffer(oss.str()));
+                            }
+                            frame.reset();
                         }
 
-                        // Send processed frame if available
-                        if (new_person_ptr == nullptr) {
-                            std::lock_guard<std::mutex> lock(processed_frame_queue_mutex);
-                            if (!processed_frame_queue.empty()) {
-                                frame = processed_frame_queue.front().first.clone();
-                                processed_frame_queue.pop();
+                        // Send the processed frames of every worker, in capture order per camera
+                        for (auto& processed_frame_ring : processed_frame_rings) {
+                            while (processed_frame_ring->pop(processed_frame)) {
+                                reorder_buffers[processed_frame.camera].push(processed_frame.seq, std::move(processed_frame));
                             }
                         }
-                        buf.clear();
-                        oss.str("");
-                        oss.clear();
-                        if (!frame.empty()) {
-                            cv::imencode(".jpg", frame, buf);
-                            std::string img_b64 = base64_encode(buf);
-                            oss << "{\"type\":\"processed\",\"image\":\"" << img_b64 << "\"}";
-                            ws.text(true);
-                            ws.write(net::buffer(oss.str()));
-                        }
-
-                        // send identify queue if available
-                        People person;
-                        {
-                            std::lock_guard<std::mutex> lock(identify_mutex);
-                            if (!identify_queue.empty()) {
-                                person = identify_queue.front();
-                                identify_queue.pop();
+                        for (auto& reorder_buffer : reorder_buffers) {
+                            // the workers drop their results while paused, start over on resume
+                            if (!is_process) reorder_buffer.reset();
+                            while (reorder_buffer.pop(processed_frame)) {
+                                // popped during enrollment capture too, those frames are just not shown
+                                if (new_person_ptr == nullptr && processed_frame.frame && !processed_frame.frame->empty()) {
+                                    buf.clear();
+                                    oss.str("");
+                                    oss.clear();
+                                    cv::imencode(".jpg", *processed_frame.frame, buf);
+                                    std::string img_b64 = base64_encode(buf);
+                                    oss << "{\"type\":\"processed\",\"camera\":" << processed_frame.camera
+                                        << ",\"image\":\"" << img_b64 << "\"}";
+                                    ws.text(true);
+                                    ws.write(net::buffer(oss.str()));
+                                }
+                                processed_frame.frame.reset();
                             }
                         }
+
+                        // send identify result if available
                         oss.str("");
                         oss.clear();
-                        if (!person.getName().empty()) {
-                            oss << "{\"type\":\"identify\",\"info\":" << person.toJsonString() << "}";
+                        if (identify_ring.pop(identification) && !identification.person.getName().empty()) {
+                            oss << "{\"type\":\"identify\",\"camera\":" << identification.camera
+                                << ",\"info\":" << identification.person.toJsonString() << "}";
                             ws.text(true);
                             ws.write(net::buffer(oss.str()));
                         }
 
-                        std::this_thread::sleep_for(std::chrono::milliseconds(33)); // ~30 FPS
+                        // sleep until any ring has something to send
+                        stream_notifier.wait_for(std::chrono::milliseconds(100), [&] {
+                            return anyPending(frame_rings) || anyPending(processed_frame_rings) ||
+                                   !identify_ring.empty() || !running.load();
+                        });
                     }
                 } catch (std::exception const& e) {
                     logger.log(Logging::LogStatus::WARNING, "WebSocket session error: " + std::string(e.what()));
@@ -0,0 +1,213 @@
+#ifndef WORK_STEALING_QUEUE_HPP
+#define WORK_STEALING_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include "frame_pool.hpp"
+
+
+// A captured frame waiting for an inference worker
+struct FrameJob {
+    size_t camera = 0;
+    uint64_t seq = 0; // per camera, set when a worker takes the job
+    FramePool::Frame frame;
+};
+
+
+/*
+    * Hands the frames of every camera to a pool of inference workers.
+    *
+    * Every worker owns a queue of tickets, one ticket per waiting frame naming its camera. The
+    * tickets of a camera are dealt round robin over the workers, starting from its home worker,
+    * so even a single camera keeps every worker busy from its own queue. A worker takes the
+    * oldest ticket of its own queue, and when that is empty steals the oldest ticket of another
+    * worker's queue, so no worker idles while frames of any camera wait.
+    *
+    * The frames themselves wait in one queue per camera, and a ticket redeems the oldest frame of
+    * its camera, whichever ticket it is: the frames of a camera leave in capture order, whichever
+    * worker takes them.
+    *
+    * A camera has at most max_pending frames waiting. submit() drops the oldest frame of the
+    * camera beyond that, so a camera the workers cannot keep up with skips frames instead of
+    * building a backlog, and it only ever drops its own frames.
+    *
+    * next() numbers the frames of each camera in the order they are taken. Every frame taken must
+    * produce one result carrying that number (an empty one when nothing was found), so the
+    * consumers can restore the order with a ReorderBuffer without waiting for frames that were
+    * dropped before they reached a worker.
+*/
+class WorkStealingQueue {
+public:
+    WorkStealingQueue(size_t cameras, size_t workers, size_t max_pending)
+        : workers_(workers), queues_(new Queue[workers]), camera_count_(cameras), cameras_(new Camera[cameras]),
+          max_pending_(max_pending) {
+        if (workers == 0 || max_pending == 0) {
+            throw std::invalid_argument("WorkStealingQueue needs at least one worker and one pending frame");
+        }
+    }
+
+    WorkStealingQueue(const WorkStealingQueue&) = delete;
+    WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+    size_t cameras() const { return camera_count_; }
+    size_t workers() const { return workers_; }
+
+    // Capture thread of camera: queue frame, and its ticket on the next worker of the camera
+    void submit(size_t camera, FramePool::Frame frame) {
+        Camera& state = this->camera(camera);
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            ++state.submitted;
+            if (state.frames.size() >= max_pending_) {
+                // the tickets already cover as many frames as before, nobody to wake
+                state.frames.pop_front();
+                state.frames.push_back(std::move(frame));
+                ++state.dropped;
+                return;
+            }
+            state.frames.push_back(std::move(frame));
+
+            // under the camera mutex, so clear() never leaves a frame without its ticket
+            Queue& queue = queues_[(camera + state.next_worker++) % workers_];
+            std::lock_guard<std::mutex> queue_lock(queue.mutex);
+            queue.tickets.push_back(camera);
+            queued_.fetch_add(1, std::memory_order_release);
+        }
+
+        // a worker between its queued_ check and its wait still holds the mutex
+        { std::lock_guard<std::mutex> lock(idle_mutex_); }
+        idle_cv_.notify_one();
+    }
+
+    // Worker: take a frame, waiting up to timeout for one, false on timeout or once stop() was called
+    template <typename Rep, typename Period>
+    bool next(size_t worker, FrameJob& job, const std::chrono::duration<Rep, Period>& timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (;;) {
+            if (stopped_.load(std::memory_order_acquire)) return false;
+
+            // own queue first, then the others starting from the next worker
+            for (size_t i = 0; i < workers_; ++i) {
+                const size_t victim = (worker + i) % workers_;
+                if (take(victim, job)) {
+                    if (i > 0) stolen_.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+
+            std::unique_lock<std::mutex> lock(idle_mutex_);
+            if (!idle_cv_.wait_until(lock, deadline, [this] {
+                    return queued_.load(std::memory_order_acquire) > 0 || stopped_.load(std::memory_order_acquire);
+                })) {
+                return false;
+            }
+        }
+    }
+
+    // Drop every waiting frame, releasing their buffers
+    void clear() {
+        for (size_t c = 0; c < camera_count_; ++c) {
+            Camera& state = cameras_[c];
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.frames.clear();
+            for (size_t w = 0; w < workers_; ++w) {
+                Queue& queue = queues_[w];
+                std::lock_guard<std::mutex> queue_lock(queue.mutex);
+                const auto end = std::remove(queue.tickets.begin(), queue.tickets.end(), c);
+                queued_.fetch_sub(static_cast<size_t>(queue.tickets.end() - end), std::memory_order_relaxed);
+                queue.tickets.erase(end, queue.tickets.end());
+            }
+        }
+    }
+
+    // Wake every waiting worker, next() returns false from now on
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            stopped_.store(true, std::memory_order_release);
+        }
+        idle_cv_.notify_all();
+    }
+
+    // Frames submitted by camera, dropped while waiting, and taken by a worker
+    uint64_t submitted(size_t camera) const { return counter(camera, &Camera::submitted); }
+    uint64_t dropped(size_t camera) const { return counter(camera, &Camera::dropped); }
+    uint64_t taken(size_t camera) const { return counter(camera, &Camera::next_seq); }
+
+    // Frames a worker took from the queue of another worker
+    uint64_t stolen() const { return stolen_.load(std::memory_order_relaxed); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tickets; // camera of each ticket
+    };
+
+    struct Camera {
+        std::mutex mutex; // taken before any queue mutex
+        std::deque<FramePool::Frame> frames;
+        size_t next_worker = 0; // offset from the home worker of the next ticket
+        uint64_t next_seq = 0;
+        uint64_t submitted = 0;
+        uint64_t dropped = 0;
+    };
+
+    const size_t workers_;
+    std::unique_ptr<Queue[]> queues_;
+    const size_t camera_count_;
+    std::unique_ptr<Camera[]> cameras_;
+    const size_t max_pending_;
+
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cv_;
+    std::atomic<size_t> queued_{0}; // tickets in all queues
+    std::atomic<bool> stopped_{false};
+    std::atomic<uint64_t> stolen_{0};
+
+    Camera& camera(size_t camera) const {
+        if (camera >= camera_count_) throw std::out_of_range("WorkStealingQueue camera out of range");
+        return cameras_[camera];
+    }
+
+    bool take(size_t worker, FrameJob& job) {
+        for (;;) {
+            size_t camera;
+            {
+                Queue& queue = queues_[worker];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.tickets.empty()) return false;
+                camera = queue.tickets.front();
+                queue.tickets.pop_front();
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            Camera& state = cameras_[camera];
+            std::lock_guard<std::mutex> lock(state.mutex);
+            // a ticket taken just before clear() finds its frame gone
+            if (state.frames.empty()) continue;
+            job.camera = camera;
+            job.frame = std::move(state.frames.front());
+            state.frames.pop_front();
+            job.seq = state.next_seq++;
+            return true;
+        }
+    }
+
+    uint64_t counter(size_t camera, uint64_t Camera::*field) const {
+        Camera& state = this->camera(camera);
+        std::lock_guard<std::mutex> lock(state.mutex);
+        return state.*field;
+    }
+};
+
+
+#endif // WORK_STEALING_QUEUE_HPP
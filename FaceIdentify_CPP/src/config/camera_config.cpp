@@ -1,4 +1,5 @@
 #include "camera_config.hpp"
+#include <map>
 
 
 CameraConfig::CameraConfig() {
@@ -8,6 +9,7 @@ CameraConfig::CameraConfig() {
     this->frame_height_ = 480;
     this->rtsp_timeout_ms_ = 5000;
     this->capture_buffer_size_ = 1;
+    this->max_fps_ = 0;
 }
 
 
@@ -19,6 +21,7 @@ CameraConfig::CameraConfig(SourceType source, const std::string& rtsp_url, int f
     this->frame_height_ = frame_height;
     this->rtsp_timeout_ms_ = rtsp_timeout_ms;
     this->capture_buffer_size_ = capture_buffer_size;
+    this->max_fps_ = 0;
 }
 
 
@@ -29,6 +32,8 @@ CameraConfig::CameraConfig(const CameraConfig& config) {
     this->frame_height_ = config.frame_height_;
     this->rtsp_timeout_ms_ = config.rtsp_timeout_ms_;
     this->capture_buffer_size_ = config.capture_buffer_size_;
+    this->max_fps_ = config.max_fps_;
+    this->extra_sources_ = config.extra_sources_;
 }
 
 
@@ -40,6 +45,8 @@ CameraConfig& CameraConfig::operator=(const CameraConfig& config) {
         this->frame_height_ = config.frame_height_;
         this->rtsp_timeout_ms_ = config.rtsp_timeout_ms_;
         this->capture_buffer_size_ = config.capture_buffer_size_;
+        this->max_fps_ = config.max_fps_;
+        this->extra_sources_ = config.extra_sources_;
     }
     return *this;
 }
@@ -49,6 +56,7 @@ void CameraConfig::load(const std::string& filename) {
     std::ifstream in(filename);
     if (!in) throw std::runtime_error("Cannot open config file: " + filename);
 
+    std::map<int, Source> extra_sources;
     std::string line;
     while (std::getline(in, line)) {
         std::istringstream iss(line);
@@ -69,12 +77,36 @@ void CameraConfig::load(const std::string& filename) {
             this->rtsp_timeout_ms_ = std::stoi(value);
         } else if (key == "capture_buffer_size") {
             this->capture_buffer_size_ = std::stoi(value);
+        } else if (key == "max_fps") {
+            this->max_fps_ = std::stoi(value);
+        } else if (key.rfind("source.", 0) == 0) {
+            int index = std::stoi(key.substr(7));
+            if (value == "INTERNAL") extra_sources[index].type = SourceType::INTERNAL;
+            else if (value == "RTSP") extra_sources[index].type = SourceType::RTSP;
+        } else if (key.rfind("rtsp_url.", 0) == 0) {
+            extra_sources[std::stoi(key.substr(9))].rtsp_url = value;
         }
     }
 
     if (this->source_ == SourceType::RTSP && this->rtsp_url_.empty()) {
         throw std::runtime_error("RTSP source is selected but no URL provided.");
     }
+    if (this->max_fps_ < 0) {
+        throw std::runtime_error("max_fps must not be negative");
+    }
+
+    this->extra_sources_.clear();
+    for (const auto& [index, source] : extra_sources) {
+        if (index != static_cast<int>(this->extra_sources_.size()) + 1) {
+            throw std::runtime_error("Camera " + std::to_string(index) + " is configured but camera " +
+                                     std::to_string(this->extra_sources_.size() + 1) + " is not.");
+        }
+        if (source.type == SourceType::RTSP && source.rtsp_url.empty()) {
+            throw std::runtime_error("RTSP source is selected for camera " + std::to_string(index) +
+                                     " but no URL provided.");
+        }
+        this->extra_sources_.push_back(source);
+    }
     in.close();
 }
 
@@ -89,6 +121,11 @@ void CameraConfig::save(const std::string& filename) const {
     out << "frame_height = " << this->frame_height_ << "\n";
     out << "rtsp_timeout_ms = " << this->rtsp_timeout_ms_ << "\n";
     out << "capture_buffer_size = " << this->capture_buffer_size_ << "\n";
+    out << "max_fps = " << this->max_fps_ << "\n";
+    for (size_t i = 0; i < this->extra_sources_.size(); ++i) {
+        out << "source." << i + 1 << " = " << sourceToString(this->extra_sources_[i].type) << "\n";
+        out << "rtsp_url." << i + 1 << " = " << this->extra_sources_[i].rtsp_url << "\n";
+    }
     out.close();
 }
 
@@ -101,7 +138,33 @@ std::string CameraConfig::toJson() const {
     oss << "  \"frame_width\": " << this->frame_width_ << ",\n";
     oss << "  \"frame_height\": " << this->frame_height_ << ",\n";
     oss << "  \"rtsp_timeout_ms\": " << this->rtsp_timeout_ms_ << ",\n";
-    oss << "  \"capture_buffer_size\": " << this->capture_buffer_size_ << "\n";
+    oss << "  \"capture_buffer_size\": " << this->capture_buffer_size_ << ",\n";
+    oss << "  \"max_fps\": " << this->max_fps_ << ",\n";
+    oss << "  \"extra_sources\": [";
+    for (size_t i = 0; i < this->extra_sources_.size(); ++i) {
+        oss << (i > 0 ? ", " : "") << "{\"source\": \"" << sourceToString(this->extra_sources_[i].type)
+            << "\", \"rtsp_url\": \"" << this->extra_sources_[i].rtsp_url << "\"}";
+    }
+    oss << "]\n";
     oss << "}";
     return oss.str();
-}
\ No newline at end of file
+}
+
+
+CameraConfig CameraConfig::camera(size_t index) const {
+    if (index >= this->camera_count()) {
+        throw std::out_of_range("Camera index out of range");
+    }
+    CameraConfig config(*this);
+    config.extra_sources_.clear();
+    if (index > 0) {
+        config.source_ = this->extra_sources_[index - 1].type;
+        config.rtsp_url_ = this->extra_sources_[index - 1].rtsp_url;
+    }
+    return config;
+}
+
+
+const char* CameraConfig::sourceToString(SourceType source) {
+    return source == SourceType::INTERNAL ? "INTERNAL" : "RTSP";
+}
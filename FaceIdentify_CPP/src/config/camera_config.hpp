@@ -5,12 +5,19 @@
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
 
 
 class CameraConfig {
 public:
     enum class SourceType { INTERNAL, RTSP };
 
+    // A camera after the first one, configured as source.N / rtsp_url.N with N from 1
+    struct Source {
+        SourceType type = SourceType::RTSP;
+        std::string rtsp_url;
+    };
+
     CameraConfig();
     CameraConfig(SourceType source, const std::string& rtsp_url, int frame_width,
                  int frame_height, int rtsp_timeout_ms,int capture_buffer_size);
@@ -25,6 +32,14 @@ public:
     inline int frame_height() const { return frame_height_; }
     inline int rtsp_timeout_ms() const { return rtsp_timeout_ms_; }
     inline int capture_buffer_size() const { return capture_buffer_size_; }
+    inline int max_fps() const { return max_fps_; }
+    inline const std::vector<Source>& extra_sources() const { return extra_sources_; }
+
+    // Cameras described, the first one by source / rtsp_url and one per extra source
+    inline size_t camera_count() const { return 1 + extra_sources_.size(); }
+
+    // Single camera config of camera index, sharing every setting but the source with this one
+    CameraConfig camera(size_t index) const;
 
     
     inline void set_source(SourceType s) { source_ = s; }
@@ -33,6 +48,8 @@ public:
     inline void set_frame_height(int h) { frame_height_ = h; }
     inline void set_rtsp_timeout_ms(int t) { rtsp_timeout_ms_ = t; }
     inline void set_capture_buffer_size(int s) { capture_buffer_size_ = s; }
+    inline void set_max_fps(int fps) { max_fps_ = fps; }
+    inline void set_extra_sources(const std::vector<Source>& sources) { extra_sources_ = sources; }
 
     // Read config from file
     void load(const std::string& filename);
@@ -50,6 +67,10 @@ private:
     int frame_height_;
     int rtsp_timeout_ms_;
     int capture_buffer_size_;
+    int max_fps_;              // capture rate cap, 0 takes frames as fast as the camera delivers
+    std::vector<Source> extra_sources_;
+
+    static const char* sourceToString(SourceType source);
 };
 
 
@@ -0,0 +1,151 @@
+#include "database_config.hpp"
+
+
+DatabaseConfig::DatabaseConfig() {
+    this->index_type_ = IndexType::FLAT;
+    this->hnsw_m_ = 16;
+    this->hnsw_ef_construction_ = 200;
+    this->hnsw_ef_search_ = 64;
+    this->quantization_ = Quantization::NONE;
+    this->rerank_candidates_ = 32;
+    this->journal_sync_every_ = 1;
+    this->journal_checkpoint_mb_ = 64;
+    this->verify_checksum_ = true;
+    this->scan_threads_ = 1;
+    this->parallel_scan_min_rows_ = 16384;
+}
+
+
+DatabaseConfig::DatabaseConfig(const DatabaseConfig& config) {
+    this->index_type_ = config.index_type_;
+    this->hnsw_m_ = config.hnsw_m_;
+    this->hnsw_ef_construction_ = config.hnsw_ef_construction_;
+    this->hnsw_ef_search_ = config.hnsw_ef_search_;
+    this->quantization_ = config.quantization_;
+    this->rerank_candidates_ = config.rerank_candidates_;
+    this->journal_sync_every_ = config.journal_sync_every_;
+    this->journal_checkpoint_mb_ = config.journal_checkpoint_mb_;
+    this->verify_checksum_ = config.verify_checksum_;
+    this->scan_threads_ = config.scan_threads_;
+    this->parallel_scan_min_rows_ = config.parallel_scan_min_rows_;
+}
+
+
+DatabaseConfig& DatabaseConfig::operator=(const DatabaseConfig& config) {
+    if (this != &config) {
+        this->index_type_ = config.index_type_;
+        this->hnsw_m_ = config.hnsw_m_;
+        this->hnsw_ef_construction_ = config.hnsw_ef_construction_;
+        this->hnsw_ef_search_ = config.hnsw_ef_search_;
+        this->quantization_ = config.quantization_;
+        this->rerank_candidates_ = config.rerank_candidates_;
+        this->journal_sync_every_ = config.journal_sync_every_;
+        this->journal_checkpoint_mb_ = config.journal_checkpoint_mb_;
+        this->verify_checksum_ = config.verify_checksum_;
+        this->scan_threads_ = config.scan_threads_;
+        this->parallel_scan_min_rows_ = config.parallel_scan_min_rows_;
+    }
+    return *this;
+}
+
+
+void DatabaseConfig::load(const std::string& filename) {
+    std::ifstream in(filename);
+    if (!in) throw std::runtime_error("Cannot open config file: " + filename);
+
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream iss(line);
+        std::string key, eq, value;
+        if (!(iss >> key >> eq >> value)) continue;
+        if (eq != "=") continue;
+
+        if (key == "index_type") {
+            if (value == "FLAT") this->index_type_ = IndexType::FLAT;
+            else if (value == "HNSW") this->index_type_ = IndexType::HNSW;
+        } else if (key == "hnsw_m") {
+            this->hnsw_m_ = std::stoi(value);
+        } else if (key == "hnsw_ef_construction") {
+            this->hnsw_ef_construction_ = std::stoi(value);
+        } else if (key == "hnsw_ef_search") {
+            this->hnsw_ef_search_ = std::stoi(value);
+        } else if (key == "quantization") {
+            if (value == "NONE") this->quantization_ = Quantization::NONE;
+            else if (value == "FP16") this->quantization_ = Quantization::FP16;
+            else if (value == "INT8") this->quantization_ = Quantization::INT8;
+        } else if (key == "rerank_candidates") {
+            this->rerank_candidates_ = std::stoi(value);
+        } else if (key == "journal_sync_every") {
+            this->journal_sync_every_ = std::stoi(value);
+        } else if (key == "journal_checkpoint_mb") {
+            this->journal_checkpoint_mb_ = std::stoi(value);
+        } else if (key == "verify_checksum") {
+            this->verify_checksum_ = std::stoi(value) != 0;
+        } else if (key == "scan_threads") {
+            this->scan_threads_ = std::stoi(value);
+        } else if (key == "parallel_scan_min_rows") {
+            this->parallel_scan_min_rows_ = std::stoi(value);
+        }
+    }
+
+    if (this->hnsw_m_ < 2 || this->hnsw_ef_construction_ < 1 || this->hnsw_ef_search_ < 1) {
+        throw std::runtime_error("Invalid HNSW parameters.");
+    }
+    if (this->rerank_candidates_ < 0) {
+        throw std::runtime_error("rerank_candidates must not be negative.");
+    }
+    if (this->journal_sync_every_ < 1 || this->journal_checkpoint_mb_ < 1) {
+        throw std::runtime_error("Invalid journal parameters.");
+    }
+    if (this->scan_threads_ < 0 || this->parallel_scan_min_rows_ < 1) {
+        throw std::runtime_error("Invalid parallel scan parameters.");
+    }
+    in.close();
+}
+
+
+void DatabaseConfig::save(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out) throw std::runtime_error("Cannot open config file: " + filename);
+
+    out << "index_type = " << (this->index_type_ == IndexType::FLAT ? "FLAT" : "HNSW") << "\n";
+    out << "hnsw_m = " << this->hnsw_m_ << "\n";
+    out << "hnsw_ef_construction = " << this->hnsw_ef_construction_ << "\n";
+    out << "hnsw_ef_search = " << this->hnsw_ef_search_ << "\n";
+    out << "quantization = " << quantizationToString(this->quantization_) << "\n";
+    out << "rerank_candidates = " << this->rerank_candidates_ << "\n";
+    out << "journal_sync_every = " << this->journal_sync_every_ << "\n";
+    out << "journal_checkpoint_mb = " << this->journal_checkpoint_mb_ << "\n";
+    out << "verify_checksum = " << (this->verify_checksum_ ? 1 : 0) << "\n";
+    out << "scan_threads = " << this->scan_threads_ << "\n";
+    out << "parallel_scan_min_rows = " << this->parallel_scan_min_rows_ << "\n";
+    out.close();
+}
+
+
+std::string DatabaseConfig::toJson() const {
+    std::ostringstream oss;
+    oss << "{\n";
+    oss << "  \"index_type\": \"" << (this->index_type_ == IndexType::FLAT ? "FLAT" : "HNSW") << "\",\n";
+    oss << "  \"hnsw_m\": " << this->hnsw_m_ << ",\n";
+    oss << "  \"hnsw_ef_construction\": " << this->hnsw_ef_construction_ << ",\n";
+    oss << "  \"hnsw_ef_search\": " << this->hnsw_ef_search_ << ",\n";
+    oss << "  \"quantization\": \"" << quantizationToString(this->quantization_) << "\",\n";
+    oss << "  \"rerank_candidates\": " << this->rerank_candidates_ << ",\n";
+    oss << "  \"journal_sync_every\": " << this->journal_sync_every_ << ",\n";
+    oss << "  \"journal_checkpoint_mb\": " << this->journal_checkpoint_mb_ << ",\n";
+    oss << "  \"verify_checksum\": " << (this->verify_checksum_ ? "true" : "false") << ",\n";
+    oss << "  \"scan_threads\": " << this->scan_threads_ << ",\n";
+    oss << "  \"parallel_scan_min_rows\": " << this->parallel_scan_min_rows_ << "\n";
+    oss << "}";
+    return oss.str();
+}
+
+
+const char* DatabaseConfig::quantizationToString(Quantization q) {
+    switch (q) {
+        case Quantization::FP16: return "FP16";
+        case Quantization::INT8: return "INT8";
+        default: return "NONE";
+    }
+}
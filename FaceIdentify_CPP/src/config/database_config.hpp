@@ -0,0 +1,67 @@
+#ifndef EMBEDDING_DATABASE_CONFIG_HPP
+#define EMBEDDING_DATABASE_CONFIG_HPP
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+class DatabaseConfig {
+public:
+    enum class IndexType { FLAT, HNSW };
+    enum class Quantization { NONE, FP16, INT8 };
+
+    DatabaseConfig();
+    DatabaseConfig(const DatabaseConfig& config);
+    DatabaseConfig& operator=(const DatabaseConfig& config);
+
+    inline IndexType index_type() const { return index_type_; }
+    inline int hnsw_m() const { return hnsw_m_; }
+    inline int hnsw_ef_construction() const { return hnsw_ef_construction_; }
+    inline int hnsw_ef_search() const { return hnsw_ef_search_; }
+    inline Quantization quantization() const { return quantization_; }
+    inline int rerank_candidates() const { return rerank_candidates_; }
+    inline int journal_sync_every() const { return journal_sync_every_; }
+    inline int journal_checkpoint_mb() const { return journal_checkpoint_mb_; }
+    inline bool verify_checksum() const { return verify_checksum_; }
+    inline int scan_threads() const { return scan_threads_; }
+    inline int parallel_scan_min_rows() const { return parallel_scan_min_rows_; }
+
+    inline void set_index_type(IndexType type) { index_type_ = type; }
+    inline void set_hnsw_m(int m) { hnsw_m_ = m; }
+    inline void set_hnsw_ef_construction(int ef) { hnsw_ef_construction_ = ef; }
+    inline void set_hnsw_ef_search(int ef) { hnsw_ef_search_ = ef; }
+    inline void set_quantization(Quantization q) { quantization_ = q; }
+    inline void set_rerank_candidates(int n) { rerank_candidates_ = n; }
+    inline void set_journal_sync_every(int n) { journal_sync_every_ = n; }
+    inline void set_journal_checkpoint_mb(int mb) { journal_checkpoint_mb_ = mb; }
+    inline void set_verify_checksum(bool verify) { verify_checksum_ = verify; }
+    inline void set_scan_threads(int n) { scan_threads_ = n; }
+    inline void set_parallel_scan_min_rows(int n) { parallel_scan_min_rows_ = n; }
+
+    // Read config from file
+    void load(const std::string& filename);
+
+    // Save config to file
+    void save(const std::string& filename) const;
+
+    // To json string representation
+    std::string toJson() const;
+
+private:
+    IndexType index_type_;
+    int hnsw_m_;
+    int hnsw_ef_construction_;
+    int hnsw_ef_search_;
+    Quantization quantization_;
+    int rerank_candidates_;
+    int journal_sync_every_;
+    int journal_checkpoint_mb_;
+    bool verify_checksum_;
+    int scan_threads_;
+    int parallel_scan_min_rows_;
+
+    static const char* quantizationToString(Quantization q);
+};
+
+#endif // EMBEDDING_DATABASE_CONFIG_HPP
@@ -28,9 +28,18 @@ ModelsConfig::ModelsConfig(const ModelsConfig& config) {
     this->facenet_path_ = config.facenet_path_;
 
     this->pnet_threshold_ = config.pnet_threshold_;
+    this->pnet_threads_ = config.pnet_threads_;
     this->rnet_threshold_ = config.rnet_threshold_;
     this->onet_threshold_ = config.onet_threshold_;
+    this->mtcnn_max_batch_ = config.mtcnn_max_batch_;
+    this->mtcnn_backend_ = config.mtcnn_backend_;
+    this->mtcnn_threads_ = config.mtcnn_threads_;
+    this->mtcnn_delegate_ = config.mtcnn_delegate_;
     this->facenet_input_shape_ = config.facenet_input_shape_;
+    this->facenet_threads_ = config.facenet_threads_;
+    this->facenet_delegate_ = config.facenet_delegate_;
+    this->facenet_precision_ = config.facenet_precision_;
+    this->inference_workers_ = config.inference_workers_;
 }
 
 
@@ -42,9 +51,18 @@ ModelsConfig& ModelsConfig::operator=(const ModelsConfig& config) {
         this->facenet_path_ = config.facenet_path_;
 
         this->pnet_threshold_ = config.pnet_threshold_;
+        this->pnet_threads_ = config.pnet_threads_;
         this->rnet_threshold_ = config.rnet_threshold_;
         this->onet_threshold_ = config.onet_threshold_;
+        this->mtcnn_max_batch_ = config.mtcnn_max_batch_;
+        this->mtcnn_backend_ = config.mtcnn_backend_;
+        this->mtcnn_threads_ = config.mtcnn_threads_;
+        this->mtcnn_delegate_ = config.mtcnn_delegate_;
         this->facenet_input_shape_ = config.facenet_input_shape_;
+        this->facenet_threads_ = config.facenet_threads_;
+        this->facenet_delegate_ = config.facenet_delegate_;
+        this->facenet_precision_ = config.facenet_precision_;
+        this->inference_workers_ = config.inference_workers_;
     }
     return *this;
 }
@@ -71,15 +89,53 @@ void ModelsConfig::load(const std::string& filename) {
             this->facenet_path_ = value;
         } else if (key == "pnet_threshold") {
             this->pnet_threshold_ = std::stof(value);
+        } else if (key == "pnet_threads") {
+            this->pnet_threads_ = std::stoi(value);
         } else if (key == "rnet_threshold") {
             this->rnet_threshold_ = std::stof(value);
         } else if (key == "onet_threshold") {
             this->onet_threshold_ = std::stof(value);
+        } else if (key == "mtcnn_max_batch") {
+            this->mtcnn_max_batch_ = std::stoi(value);
+        } else if (key == "mtcnn_backend") {
+            if (value == "CAFFE") this->mtcnn_backend_ = MtcnnBackend::CAFFE;
+            else if (value == "TFLITE") this->mtcnn_backend_ = MtcnnBackend::TFLITE;
+        } else if (key == "mtcnn_threads") {
+            this->mtcnn_threads_ = std::stoi(value);
+        } else if (key == "mtcnn_delegate") {
+            if (value == "NONE") this->mtcnn_delegate_ = Delegate::NONE;
+            else if (value == "XNNPACK") this->mtcnn_delegate_ = Delegate::XNNPACK;
         } else if (key == "facenet_input_shape") {
             this->facenet_input_shape_ = std::stoi(value);
+        } else if (key == "facenet_threads") {
+            this->facenet_threads_ = std::stoi(value);
+        } else if (key == "facenet_delegate") {
+            if (value == "NONE") this->facenet_delegate_ = Delegate::NONE;
+            else if (value == "XNNPACK") this->facenet_delegate_ = Delegate::XNNPACK;
+        } else if (key == "facenet_precision") {
+            if (value == "FP32") this->facenet_precision_ = Precision::FP32;
+            else if (value == "FP16") this->facenet_precision_ = Precision::FP16;
+        } else if (key == "inference_workers") {
+            this->inference_workers_ = std::stoi(value);
         }
     }
     in.close();
+
+    if (this->pnet_threads_ < 0) {
+        throw std::runtime_error("pnet_threads must not be negative");
+    }
+    if (this->mtcnn_max_batch_ < 1) {
+        throw std::runtime_error("mtcnn_max_batch must be at least 1");
+    }
+    if (this->mtcnn_threads_ < 1) {
+        throw std::runtime_error("mtcnn_threads must be at least 1");
+    }
+    if (this->facenet_threads_ < 1) {
+        throw std::runtime_error("facenet_threads must be at least 1");
+    }
+    if (this->inference_workers_ < 1) {
+        throw std::runtime_error("inference_workers must be at least 1");
+    }
 }
 
 
@@ -93,9 +149,18 @@ void ModelsConfig::save(const std::string& filename) const {
     out << "facenet_path = " << this->facenet_path_ << "\n";
     
     out << "pnet_threshold = " << this->pnet_threshold_ << "\n";
+    out << "pnet_threads = " << this->pnet_threads_ << "\n";
     out << "rnet_threshold = " << this->rnet_threshold_ << "\n";
     out << "onet_threshold = " << this->onet_threshold_ << "\n";
+    out << "mtcnn_max_batch = " << this->mtcnn_max_batch_ << "\n";
+    out << "mtcnn_backend = " << backendToString(this->mtcnn_backend_) << "\n";
+    out << "mtcnn_threads = " << this->mtcnn_threads_ << "\n";
+    out << "mtcnn_delegate = " << delegateToString(this->mtcnn_delegate_) << "\n";
     out << "facenet_input_shape = " << this->facenet_input_shape_ << "\n";
+    out << "facenet_threads = " << this->facenet_threads_ << "\n";
+    out << "facenet_delegate = " << delegateToString(this->facenet_delegate_) << "\n";
+    out << "facenet_precision = " << precisionToString(this->facenet_precision_) << "\n";
+    out << "inference_workers = " << this->inference_workers_ << "\n";
 
     out.close();
 }
@@ -106,12 +171,36 @@ std::string ModelsConfig::toJson() const {
     oss << "{\n";
     oss << "  \"pnet_path\": \"" << this->pnet_path_ << "\",\n";
     oss << "  \"pnet_threshold\": " << this->pnet_threshold_ << ",\n";
+    oss << "  \"pnet_threads\": " << this->pnet_threads_ << ",\n";
     oss << "  \"rnet_path\": \"" << this->rnet_path_ << "\",\n";
     oss << "  \"rnet_threshold\": " << this->rnet_threshold_ << ",\n";
     oss << "  \"onet_path\": \"" << this->onet_path_ << "\",\n";
     oss << "  \"onet_threshold\": " << this->onet_threshold_ << ",\n";
-    oss << "  \"facenet_path\": \"" << this->facenet_path_ << "\"\n";
-    oss << "  \"facenet_input_shape\": " << this->facenet_input_shape_ << "\n";
+    oss << "  \"mtcnn_max_batch\": " << this->mtcnn_max_batch_ << ",\n";
+    oss << "  \"mtcnn_backend\": \"" << backendToString(this->mtcnn_backend_) << "\",\n";
+    oss << "  \"mtcnn_threads\": " << this->mtcnn_threads_ << ",\n";
+    oss << "  \"mtcnn_delegate\": \"" << delegateToString(this->mtcnn_delegate_) << "\",\n";
+    oss << "  \"facenet_path\": \"" << this->facenet_path_ << "\",\n";
+    oss << "  \"facenet_input_shape\": " << this->facenet_input_shape_ << ",\n";
+    oss << "  \"facenet_threads\": " << this->facenet_threads_ << ",\n";
+    oss << "  \"facenet_delegate\": \"" << delegateToString(this->facenet_delegate_) << "\",\n";
+    oss << "  \"facenet_precision\": \"" << precisionToString(this->facenet_precision_) << "\",\n";
+    oss << "  \"inference_workers\": " << this->inference_workers_ << "\n";
     oss << "}";
     return oss.str();
-}
\ No newline at end of file
+}
+
+
+const char* ModelsConfig::backendToString(MtcnnBackend backend) {
+    return backend == MtcnnBackend::TFLITE ? "TFLITE" : "CAFFE";
+}
+
+
+const char* ModelsConfig::delegateToString(Delegate delegate) {
+    return delegate == Delegate::XNNPACK ? "XNNPACK" : "NONE";
+}
+
+
+const char* ModelsConfig::precisionToString(Precision precision) {
+    return precision == Precision::FP16 ? "FP16" : "FP32";
+}
@@ -8,6 +8,10 @@
 
 class ModelsConfig {
 public:
+    enum class MtcnnBackend { CAFFE, TFLITE };
+    enum class Delegate { NONE, XNNPACK };
+    enum class Precision { FP32, FP16 };
+
     ModelsConfig();
     ModelsConfig(const std::string& pnet_path,
                  const std::string& rnet_path,
@@ -19,21 +23,39 @@ public:
 
     inline const std::string& pnet_path() const { return pnet_path_; }
     inline float pnet_threshold() const { return pnet_threshold_; }
+    inline int pnet_threads() const { return pnet_threads_; }
     inline const std::string& rnet_path() const { return rnet_path_; }
     inline float rnet_threshold() const { return rnet_threshold_; }
     inline const std::string& onet_path() const { return onet_path_; }
     inline float onet_threshold() const { return onet_threshold_; }
+    inline int mtcnn_max_batch() const { return mtcnn_max_batch_; }
+    inline MtcnnBackend mtcnn_backend() const { return mtcnn_backend_; }
+    inline int mtcnn_threads() const { return mtcnn_threads_; }
+    inline Delegate mtcnn_delegate() const { return mtcnn_delegate_; }
     inline const std::string& facenet_path() const { return facenet_path_; }
     inline int facenet_input_shape() const { return facenet_input_shape_; }
+    inline int facenet_threads() const { return facenet_threads_; }
+    inline Delegate facenet_delegate() const { return facenet_delegate_; }
+    inline Precision facenet_precision() const { return facenet_precision_; }
+    inline int inference_workers() const { return inference_workers_; }
 
     inline void set_pnet_path(const std::string& path) { pnet_path_ = path; }
     inline void set_pnet_threshold(float threshold) { pnet_threshold_ = threshold; }
+    inline void set_pnet_threads(int threads) { pnet_threads_ = threads; }
     inline void set_rnet_path(const std::string& path) { rnet_path_ = path; }
     inline void set_rnet_threshold(float threshold) { rnet_threshold_ = threshold; }
     inline void set_onet_path(const std::string& path) { onet_path_ = path; }
     inline void set_onet_threshold(float threshold) { onet_threshold_ = threshold; }
+    inline void set_mtcnn_max_batch(int batch) { mtcnn_max_batch_ = batch; }
+    inline void set_mtcnn_backend(MtcnnBackend backend) { mtcnn_backend_ = backend; }
+    inline void set_mtcnn_threads(int threads) { mtcnn_threads_ = threads; }
+    inline void set_mtcnn_delegate(Delegate delegate) { mtcnn_delegate_ = delegate; }
     inline void set_facenet_path(const std::string& path) { facenet_path_ = path; }
     inline void set_facenet_input_shape(int shape) { facenet_input_shape_ = shape; }
+    inline void set_facenet_threads(int threads) { facenet_threads_ = threads; }
+    inline void set_facenet_delegate(Delegate delegate) { facenet_delegate_ = delegate; }
+    inline void set_facenet_precision(Precision precision) { facenet_precision_ = precision; }
+    inline void set_inference_workers(int workers) { inference_workers_ = workers; }
 
     // Read config from file
     void load(const std::string& filename);
@@ -47,12 +69,25 @@ public:
 private:
     std::string pnet_path_;
     float pnet_threshold_ = 0.6f;
+    int pnet_threads_ = 1;     // PNet pyramid levels run concurrently, 0 uses every core
     std::string rnet_path_;
     float rnet_threshold_ = 0.7f;
     std::string onet_path_;
     float onet_threshold_ = 0.7f;
+    int mtcnn_max_batch_ = 64; // RNet / ONet candidates per forward pass
+    MtcnnBackend mtcnn_backend_ = MtcnnBackend::CAFFE;
+    int mtcnn_threads_ = 1;    // TFLite interpreter threads per network
+    Delegate mtcnn_delegate_ = Delegate::XNNPACK;
     std::string facenet_path_;
     int facenet_input_shape_ = 160;
+    int facenet_threads_ = 1;  // TFLite interpreter threads
+    Delegate facenet_delegate_ = Delegate::XNNPACK;
+    Precision facenet_precision_ = Precision::FP32; // FP16 lets XNNPACK compute in half precision
+    int inference_workers_ = 1; // detector / embedding instances shared by every camera
+
+    static const char* backendToString(MtcnnBackend backend);
+    static const char* delegateToString(Delegate delegate);
+    static const char* precisionToString(Precision precision);
 };
 
 #endif // MTCNN_FACENET_MODELS_CONFIG_HPP
\ No newline at end of file
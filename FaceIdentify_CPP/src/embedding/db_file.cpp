@@ -0,0 +1,109 @@
+#include "db_file.hpp"
+
+#include <array>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+uint32_t db_file_crc32(const void* data, size_t size, uint32_t crc) {
+    // Slicing-by-8: table[k][b] is the CRC of byte b followed by k zero bytes, so eight bytes
+    // are folded per step with independent lookups instead of eight dependent ones
+    static const std::array<std::array<uint32_t, 256>, 8> table = [] {
+        std::array<std::array<uint32_t, 256>, 8> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[0][i] = c;
+        }
+        for (size_t k = 1; k < 8; ++k) {
+            for (uint32_t i = 0; i < 256; ++i) {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+        return t;
+    }();
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (; size >= 8; bytes += 8, size -= 8) {
+        uint32_t lo = crc ^ (uint32_t{bytes[0]} | uint32_t{bytes[1]} << 8 | uint32_t{bytes[2]} << 16 |
+                             uint32_t{bytes[3]} << 24);
+        uint32_t hi = uint32_t{bytes[4]} | uint32_t{bytes[5]} << 8 | uint32_t{bytes[6]} << 16 |
+                      uint32_t{bytes[7]} << 24;
+        crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^ table[5][(lo >> 16) & 0xFF] ^
+              table[4][lo >> 24] ^ table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^
+              table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+    }
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[0][(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+
+uint32_t db_file_header_crc32(DBFileHeader header) {
+    header.header_checksum = 0;
+    return db_file_crc32(&header, sizeof(header));
+}
+
+
+bool db_file_sync(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+
+bool db_file_sync_dir(const std::string& filename) {
+    std::string::size_type slash = filename.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : filename.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+
+bool db_file_replace(const std::string& tmp_filename, const std::string& filename) {
+    if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp_filename.c_str());
+        return false;
+    }
+    return db_file_sync_dir(filename);
+}
+
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    void* addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (addr == MAP_FAILED) return nullptr;
+
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->data_ = static_cast<const uint8_t*>(addr);
+    file->size_ = static_cast<size_t>(st.st_size);
+    return file;
+}
+
+
+MappedFile::~MappedFile() {
+    if (this->data_) {
+        ::munmap(const_cast<uint8_t*>(this->data_), this->size_);
+    }
+}
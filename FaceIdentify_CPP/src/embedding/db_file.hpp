@@ -0,0 +1,80 @@
+#ifndef __embedding_db_file_hpp__
+#define __embedding_db_file_hpp__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+
+// On-disk layout of an EmbeddingDB file (version 2), all integers in host byte order:
+//
+//   DBFileHeader                                  (byte_order detects a foreign endianness)
+//   rows   count x dim float32, unit-normalized   (row-major, DB_FILE_ALIGNMENT aligned)
+//   norms  count float32                          (original L2 norm of each row)
+//   infos  (count + 1) uint64 offsets into the info text blob, then the blob itself
+//
+// checksum is the CRC-32 of the whole file with both checksum fields zeroed, header_checksum
+// the CRC-32 of the header with header_checksum zeroed. The header checksum is cheap enough to
+// check on every load, the full checksum is checked on request.
+struct DBFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t dim;
+    uint64_t count;
+    uint64_t rows_offset;
+    uint64_t norms_offset;
+    uint64_t infos_offset;
+    uint64_t file_size;
+    uint32_t checksum;
+    uint32_t header_checksum;
+};
+
+constexpr char DB_FILE_MAGIC[8] = {'F', 'I', 'D', 'B', 'E', 'M', 'B', '\0'};
+constexpr uint32_t DB_FILE_VERSION = 2;
+constexpr uint32_t DB_FILE_BYTE_ORDER = 0x01020304;
+constexpr size_t DB_FILE_ALIGNMENT = 64;
+
+inline uint64_t db_file_align(uint64_t offset) {
+    return (offset + DB_FILE_ALIGNMENT - 1) / DB_FILE_ALIGNMENT * DB_FILE_ALIGNMENT;
+}
+
+// CRC-32 (IEEE 802.3), crc is the value returned by a previous call to continue a running checksum
+uint32_t db_file_crc32(const void* data, size_t size, uint32_t crc = 0);
+
+// CRC-32 of header with header_checksum zeroed, the value header_checksum must hold
+uint32_t db_file_header_crc32(DBFileHeader header);
+
+// fsync a file that was written through a stream, false if it cannot be opened or flushed
+bool db_file_sync(const std::string& filename);
+
+// fsync the directory holding filename, so a rename onto filename survives a crash
+bool db_file_sync_dir(const std::string& filename);
+
+// Rename tmp_filename onto filename and fsync the directory, tmp_filename is removed if the
+// rename fails
+bool db_file_replace(const std::string& tmp_filename, const std::string& filename);
+
+
+// Read-only memory mapping of a whole file, unmapped when the last reference goes away
+class MappedFile {
+public:
+    // nullptr if the file cannot be opened or mapped
+    static std::shared_ptr<const MappedFile> open(const std::string& filename);
+
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+#endif // __embedding_db_file_hpp__
@@ -0,0 +1,199 @@
+#include "db_journal.hpp"
+#include "db_file.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace {
+
+constexpr size_t RECORD_OVERHEAD = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);
+
+bool write_all(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Empty journal at "<filename>.tmp", flushed to stable storage, -1 on failure
+int create_aside(const std::string& filename, uint64_t dim, uint32_t base_checksum) {
+    DBJournalHeader header{};
+    std::memcpy(header.magic, DB_JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = DB_JOURNAL_VERSION;
+    header.byte_order = DB_FILE_BYTE_ORDER;
+    header.dim = dim;
+    header.base_checksum = base_checksum;
+
+    const std::string tmp_filename = filename + ".tmp";
+    int fd = ::open(tmp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) return -1;
+    if (!write_all(fd, &header, sizeof(header)) || ::fdatasync(fd) != 0) {
+        ::close(fd);
+        std::remove(tmp_filename.c_str());
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace
+
+
+DBJournal::DBJournal(int fd, const std::string& filename, uint64_t dim, uint64_t bytes, size_t sync_every)
+    : fd_(fd), filename_(filename), dim_(dim), bytes_(bytes), sync_every_(sync_every == 0 ? 1 : sync_every) {}
+
+
+DBJournal::~DBJournal() {
+    this->cancel_restart();
+    if (this->fd_ < 0) return;
+    this->commit();
+    if (this->unsynced_ > 0) this->sync();
+    ::close(this->fd_);
+}
+
+
+std::unique_ptr<DBJournal> DBJournal::create(const std::string& filename, uint64_t dim, uint32_t base_checksum,
+                                             size_t sync_every) {
+    // Written aside and renamed, so the old journal stays intact until the new one is durable
+    int fd = create_aside(filename, dim, base_checksum);
+    if (fd < 0) return nullptr;
+    if (!db_file_replace(filename + ".tmp", filename)) {
+        ::close(fd);
+        return nullptr;
+    }
+    return std::unique_ptr<DBJournal>(new DBJournal(fd, filename, dim, sizeof(DBJournalHeader), sync_every));
+}
+
+
+bool DBJournal::prepare_restart(uint32_t base_checksum) {
+    this->cancel_restart();
+    if (!this->commit()) return false;
+    this->pending_fd_ = create_aside(this->filename_, this->dim_, base_checksum);
+    return this->pending_fd_ >= 0;
+}
+
+
+bool DBJournal::finish_restart() {
+    if (this->pending_fd_ < 0) return false;
+    const int fresh = this->pending_fd_;
+    this->pending_fd_ = -1;
+    if (this->fd_ >= 0) ::close(this->fd_);
+    this->bytes_ = sizeof(DBJournalHeader);
+    this->unsynced_ = 0;
+    this->buffer_.clear();
+    if (!db_file_replace(this->filename_ + ".tmp", this->filename_)) {
+        ::close(fresh);
+        this->fd_ = -1;
+        return false;
+    }
+    this->fd_ = fresh;
+    return true;
+}
+
+
+void DBJournal::cancel_restart() {
+    if (this->pending_fd_ < 0) return;
+    ::close(this->pending_fd_);
+    this->pending_fd_ = -1;
+    std::remove((this->filename_ + ".tmp").c_str());
+}
+
+
+std::unique_ptr<DBJournal> DBJournal::open(const std::string& filename, uint64_t dim, uint32_t base_checksum,
+                                           size_t sync_every) {
+    uint64_t length = valid_length(filename, dim, base_checksum, nullptr, nullptr);
+    if (length == 0) return nullptr;
+
+    int fd = ::open(filename.c_str(), O_WRONLY | O_APPEND);
+    if (fd < 0) return nullptr;
+    if (::ftruncate(fd, static_cast<off_t>(length)) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    return std::unique_ptr<DBJournal>(new DBJournal(fd, filename, dim, length, sync_every));
+}
+
+
+bool DBJournal::replay(const std::string& filename, uint64_t dim, uint32_t base_checksum, const RecordHandler& fn) {
+    bool rejected = false;
+    uint64_t length = valid_length(filename, dim, base_checksum, &fn, &rejected);
+    return length > 0 && !rejected;
+}
+
+
+uint64_t DBJournal::valid_length(const std::string& filename, uint64_t dim, uint32_t base_checksum,
+                                 const RecordHandler* fn, bool* rejected) {
+    std::shared_ptr<const MappedFile> file = MappedFile::open(filename);
+    if (!file || file->size() < sizeof(DBJournalHeader)) return 0;
+
+    DBJournalHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, DB_JOURNAL_MAGIC, sizeof(header.magic)) != 0) return 0;
+    if (header.version != DB_JOURNAL_VERSION || header.byte_order != DB_FILE_BYTE_ORDER) return 0;
+    if (header.dim != dim || header.base_checksum != base_checksum) return 0;
+
+    const uint8_t* data = file->data();
+    uint64_t offset = sizeof(header);
+    while (file->size() - offset >= RECORD_OVERHEAD) {
+        uint32_t size;
+        std::memcpy(&size, data + offset, sizeof(size));
+        if (size > file->size() - offset - RECORD_OVERHEAD) break;
+
+        const uint8_t* body = data + offset + sizeof(size); // type byte then payload
+        uint32_t crc;
+        std::memcpy(&crc, body + 1 + size, sizeof(crc));
+        if (db_file_crc32(body, 1 + size) != crc) break;
+
+        if (fn && !(*fn)(static_cast<DBJournalRecord>(body[0]), body + 1, size)) {
+            if (rejected) *rejected = true;
+            break;
+        }
+        offset += RECORD_OVERHEAD + size;
+    }
+    return offset;
+}
+
+
+void DBJournal::append(DBJournalRecord type, const void* payload, size_t size) {
+    uint32_t size32 = static_cast<uint32_t>(size);
+    uint8_t type8 = static_cast<uint8_t>(type);
+    uint32_t crc = db_file_crc32(&type8, 1);
+    crc = db_file_crc32(payload, size, crc);
+
+    this->buffer_.append(reinterpret_cast<const char*>(&size32), sizeof(size32));
+    this->buffer_.push_back(static_cast<char>(type8));
+    this->buffer_.append(static_cast<const char*>(payload), size);
+    this->buffer_.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+}
+
+
+bool DBJournal::commit() {
+    if (this->buffer_.empty()) return true;
+    if (this->fd_ < 0) {
+        this->buffer_.clear();
+        return false;
+    }
+    bool ok = write_all(this->fd_, this->buffer_.data(), this->buffer_.size());
+    if (ok && ++this->unsynced_ >= this->sync_every_) ok = this->sync();
+    if (ok) {
+        this->bytes_ += this->buffer_.size();
+    } else {
+        // A failed commit leaves none of its records behind: the caller does not apply them,
+        // and later records are not appended behind garbage
+        ::ftruncate(this->fd_, static_cast<off_t>(this->bytes_));
+    }
+    this->buffer_.clear();
+    return ok;
+}
+
+
+bool DBJournal::sync() {
+    this->unsynced_ = 0;
+    return this->fd_ >= 0 && ::fdatasync(this->fd_) == 0;
+}
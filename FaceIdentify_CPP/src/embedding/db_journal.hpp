@@ -0,0 +1,100 @@
+#ifndef __embedding_db_journal_hpp__
+#define __embedding_db_journal_hpp__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+
+// Append-only write-ahead log of EmbeddingDB mutations since the last snapshot, all integers
+// in host byte order:
+//
+//   DBJournalHeader                        (base_checksum ties the journal to one snapshot)
+//   records  uint32 payload size, uint8 type, payload, uint32 CRC-32 of type and payload
+//
+// A record cut short by a crash fails its size or checksum check, replay stops there and
+// the next writer truncates the torn tail.
+struct DBJournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t dim;
+    uint32_t base_checksum;
+    uint32_t reserved;
+};
+
+enum class DBJournalRecord : uint8_t {
+    INSERT = 1,  // float norm, dim float32 unit-normalized row, info text
+    ERASE = 2,   // uint64 slot
+    COMPACT = 3, // no payload
+};
+
+constexpr char DB_JOURNAL_MAGIC[8] = {'F', 'I', 'D', 'B', 'W', 'A', 'L', '\0'};
+constexpr uint32_t DB_JOURNAL_VERSION = 1;
+
+
+class DBJournal {
+public:
+    using RecordHandler = std::function<bool(DBJournalRecord type, const uint8_t* payload, size_t size)>;
+
+    // Start an empty journal for the snapshot with the given checksum, replacing any existing file
+    static std::unique_ptr<DBJournal> create(const std::string& filename, uint64_t dim, uint32_t base_checksum,
+                                             size_t sync_every);
+
+    // Continue the journal of the snapshot with the given checksum, dropping a torn tail.
+    // nullptr if the file is missing, unreadable or belongs to another snapshot.
+    static std::unique_ptr<DBJournal> open(const std::string& filename, uint64_t dim, uint32_t base_checksum,
+                                           size_t sync_every);
+
+    // Pass every intact record to fn in order. False if the journal is missing, belongs to another
+    // snapshot or fn rejects a record.
+    static bool replay(const std::string& filename, uint64_t dim, uint32_t base_checksum, const RecordHandler& fn);
+
+    ~DBJournal();
+    DBJournal(const DBJournal&) = delete;
+    DBJournal& operator=(const DBJournal&) = delete;
+
+    // Buffer a record, nothing reaches the file before commit()
+    void append(DBJournalRecord type, const void* payload, size_t size);
+
+    // Write the buffered records in one call, fsync once every sync_every commits.
+    // On failure the records are dropped from the buffer and the file.
+    bool commit();
+
+    // Flush the file to stable storage now
+    bool sync();
+
+    // Empty the journal and tie it to a new snapshot, in two steps so the snapshot can replace
+    // the old one in between: prepare_restart() writes the empty journal aside, finish_restart()
+    // puts it in place of this one, cancel_restart() drops it. The old records stay until
+    // finish_restart() succeeds. If it fails the journal no longer matches either snapshot and
+    // is closed, every commit() fails until a later restart succeeds.
+    bool prepare_restart(uint32_t base_checksum);
+    bool finish_restart();
+    void cancel_restart();
+
+    const std::string& filename() const { return filename_; }
+
+    // Bytes written to the journal file, header included
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    DBJournal(int fd, const std::string& filename, uint64_t dim, uint64_t bytes, size_t sync_every);
+
+    // Size of the header plus every intact record, 0 if the header does not match
+    static uint64_t valid_length(const std::string& filename, uint64_t dim, uint32_t base_checksum,
+                                 const RecordHandler* fn, bool* rejected);
+
+    int fd_;              // -1 once closed by a failed restart
+    int pending_fd_ = -1; // journal written aside by prepare_restart()
+    std::string filename_;
+    uint64_t dim_;
+    uint64_t bytes_;
+    size_t sync_every_;
+    size_t unsynced_ = 0;
+    std::string buffer_;
+};
+
+#endif // __embedding_db_journal_hpp__
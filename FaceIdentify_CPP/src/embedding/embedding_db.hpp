@@ -2,19 +2,187 @@
 #define __embedding_db_hpp__
 
 #include "utils.hpp"
+#include "db_file.hpp"
+#include "db_journal.hpp"
+#include "hnsw_index.hpp"
+#include "quantized_rows.hpp"
+#include "scan_pool.hpp"
+#include <memory>
 #include <unordered_map>
+#include <algorithm>
 #include <type_traits>
 #include <fstream>
+#include <cstring>
+#include <bit>
+#include <limits>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
 
 
+// Embedding database for one writer and any number of concurrent readers.
+//
+// Every mutation runs under a writer mutex and ends by publishing an immutable Snapshot with an
+// atomic pointer swap. Readers load the current snapshot and query it without locks, so
+// identification keeps running while enrollments, erases or compactions happen. The query
+// methods of EmbeddingDB use the latest snapshot for every call; hold a snapshot() to look up
+// the info of a result index from the same version of the database.
 template<typename InfoType>
 class EmbeddingDB {
+    struct Storage;
+    struct Graph;
+
 public:
     using EmbeddingType = Eigen::MatrixXf;
     using InfoTypeT = InfoType;
+    using RowMatrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    using RowsView = Eigen::Map<const RowMatrix>;
+    using NormsView = Eigen::Map<const Eigen::VectorXf>;
+
+    // One published version of the database. It keeps its rows, infos, quantized copy and
+    // tombstones alive, indices returned by its queries stay valid for its info() / embedding().
+    class Snapshot {
+    public:
+        // query information of nearest embedding
+        std::pair<size_t, double> query_nearest(const EmbeddingType& embedding) const;
+        std::pair<size_t, double> query_nearest(const std::vector<float>& embedding) const;
+
+        // query nearest embedding for every row of a K x embedding_dim matrix in one GEMM pass
+        std::vector<std::pair<size_t, double>> query_nearest_batch(const EmbeddingType& queries) const;
+
+        // query the k nearest embeddings, ordered by increasing distance
+        std::vector<std::pair<size_t, double>> query_topk(const EmbeddingType& embedding, size_t k) const;
+        std::vector<std::pair<size_t, double>> query_topk(const std::vector<float>& embedding, size_t k) const;
+
+        // query all embeddings within max_distance, ordered by increasing distance
+        std::vector<std::pair<size_t, double>> query_radius(const EmbeddingType& embedding, double max_distance) const;
+        std::vector<std::pair<size_t, double>> query_radius(const std::vector<float>& embedding, double max_distance) const;
+
+        // Get all embeddings (unit-normalized rows), one per slot including erased ones
+        RowsView embeddings() const {
+            return RowsView(storage_->rows_data, slots_, dim_);
+        }
+
+        // Get the original L2 norm of every stored embedding
+        NormsView norms() const {
+            return NormsView(storage_->norms_data, slots_);
+        }
+
+        // Get all infos, one per slot including erased ones
+        std::span<const InfoType> infos() const {
+            return std::span<const InfoType>(storage_->infos.data(), slots_);
+        }
+
+        // Get size (number of live embeddings)
+        size_t size() const {
+            return slots_ - erased_count_;
+        }
+
+        // Number of slots, live or erased. Query results index slots.
+        size_t slots() const {
+            return slots_;
+        }
+
+        size_t embedding_dim() const {
+            return dim_;
+        }
+
+        bool is_erased(size_t idx) const {
+            return erased_ && idx / 64 < erased_->size() && ((*erased_)[idx / 64] >> (idx % 64)) & 1;
+        }
+
+        // True while the rows are served straight from a mapped file
+        bool is_mapped() const {
+            return storage_->mapping != nullptr;
+        }
+
+        size_t capacity() const {
+            return storage_->capacity;
+        }
+
+        const QuantizedRows* quantized() const {
+            return quantized_.get();
+        }
+
+        // Access embedding and info by index
+        EmbeddingType embedding(size_t idx) const {
+            if (size() == 0) throw std::out_of_range("No embeddings stored");
+            if (idx >= slots_) throw std::out_of_range("Embedding index out of range");
+            if (is_erased(idx)) throw std::out_of_range("Embedding index was erased");
+            return embeddings().row(idx) * norms()(idx);
+        }
+
+        const InfoType& info(size_t idx) const {
+            if (idx >= slots_) throw std::out_of_range("Embedding index out of range");
+            if (is_erased(idx)) throw std::out_of_range("Embedding index was erased");
+            return storage_->infos[idx];
+        }
+
+    private:
+        friend class EmbeddingDB;
+        using QueryRow = Eigen::Ref<const Eigen::RowVectorXf, 0, Eigen::InnerStride<>>;
+
+        std::pair<size_t, double> nearest(const QueryRow& query) const;
+        std::vector<std::pair<size_t, double>> topk(const QueryRow& query, size_t k) const;
+        std::vector<std::pair<size_t, double>> radius(const QueryRow& query, double max_distance) const;
+
+        // Dot products of the query against every stored row, in a per-thread buffer
+        const Eigen::VectorXf& scores(const QueryRow& query) const;
+
+        // Same as scores() but from the quantized rows when quantization is enabled
+        const Eigen::VectorXf& approx_scores(const QueryRow& query) const;
+
+        // Number of row shards a scan is split into on the pool, 1 keeps it on the calling thread
+        size_t shards() const {
+            return pool_ && slots_ >= parallel_min_rows_ ? (slots_ + shard_rows_ - 1) / shard_rows_ : 1;
+        }
+
+        // Rows [first, first + count) of shard s
+        std::pair<size_t, size_t> shard_range(size_t s) const {
+            size_t first = s * shard_rows_;
+            return {first, std::min(shard_rows_, slots_ - first)};
+        }
+
+        // Dot products of the query against rows [first, first + count) into out, erased slots -inf.
+        // approx scans the quantized rows when quantization is enabled.
+        void shard_scores(const Eigen::RowVectorXf& query, size_t first, size_t count, bool approx, float* out) const;
+
+        // Keep the k best (dot, first + i) of dots[0, count) in a min-heap on the dot product
+        static void select_topk(std::vector<std::pair<float, size_t>>& heap, size_t k, const float* dots,
+                                size_t first, size_t count);
+
+        // Call fn(idx) for every erased slot, one bitmap word at a time
+        template<typename Fn>
+        void for_each_erased(Fn&& fn) const {
+            if (erased_count_ == 0) return;
+            for (size_t w = 0; w < erased_->size(); ++w) {
+                for (uint64_t bits = (*erased_)[w]; bits; bits &= bits - 1) {
+                    fn(w * 64 + std::countr_zero(bits));
+                }
+            }
+        }
+
+        // Set the scores of erased slots to -inf so no scan can pick them
+        void mask_erased(Eigen::VectorXf& dots) const {
+            for_each_erased([&](size_t idx) { dots(idx) = -std::numeric_limits<float>::infinity(); });
+        }
+
+        std::shared_ptr<const Storage> storage_;
+        std::shared_ptr<const QuantizedRows> quantized_;
+        std::shared_ptr<const Graph> graph_;
+        std::shared_ptr<const std::vector<uint64_t>> erased_;
+        size_t erased_count_ = 0;
+        size_t slots_ = 0;
+        size_t dim_ = 0;
+        size_t rerank_ = 0;
+        std::shared_ptr<ScanPool> pool_;
+        size_t parallel_min_rows_ = 0;
+        size_t shard_rows_ = 0;
+    };
 
     // Constructor
-    EmbeddingDB() = default;
+    EmbeddingDB() : EmbeddingDB(0) {}
     explicit EmbeddingDB(size_t embedding_dim);
     EmbeddingDB(const EmbeddingDB&) = delete; // Disable copy constructor
     EmbeddingDB& operator=(const EmbeddingDB&) = delete; // Disable copy assignment
@@ -22,71 +190,280 @@ public:
     //destructor
     ~EmbeddingDB() {this->clear();}
 
+    // Current version of the database, cheap to take and safe to use from any thread
+    std::shared_ptr<const Snapshot> snapshot() const {
+        return snapshot_.load(std::memory_order_acquire);
+    }
+
     // Add an embedding with associated info
     bool insert(const EmbeddingType& embedding, const InfoType& info);
     bool insert (const EmbeddingType& embeddings, const std::vector<InfoType>& infos);
     bool insert(const std::vector<float>& embedding, const InfoType& info);
     bool insert(const std::vector<std::vector<float>>& embeddings, const std::vector<InfoType>& infos);
 
-    // delete an embedding by index
+    // delete an embedding by index. Erased slots are tombstoned and skipped by every query;
+    // once they exceed the compaction ratio the live rows are compacted and renumbered.
     bool erase(size_t idx);
     bool erase(const InfoType& info);
     bool erase(const std::vector<InfoType>& infos);
     bool erase(const std::vector<size_t>& idxs);
 
     // query information of nearest embedding
-    std::pair<size_t, double> query_nearest(const EmbeddingType& embedding) const;
-    std::pair<size_t, double> query_nearest(const std::vector<float>& embedding) const;
+    std::pair<size_t, double> query_nearest(const EmbeddingType& embedding) const {
+        return snapshot()->query_nearest(embedding);
+    }
+    std::pair<size_t, double> query_nearest(const std::vector<float>& embedding) const {
+        return snapshot()->query_nearest(embedding);
+    }
+
+    // query nearest embedding for every row of a K x embedding_dim matrix in one GEMM pass
+    std::vector<std::pair<size_t, double>> query_nearest_batch(const EmbeddingType& queries) const {
+        return snapshot()->query_nearest_batch(queries);
+    }
+
+    // query the k nearest embeddings, ordered by increasing distance
+    std::vector<std::pair<size_t, double>> query_topk(const EmbeddingType& embedding, size_t k) const {
+        return snapshot()->query_topk(embedding, k);
+    }
+    std::vector<std::pair<size_t, double>> query_topk(const std::vector<float>& embedding, size_t k) const {
+        return snapshot()->query_topk(embedding, k);
+    }
+
+    // query all embeddings within max_distance, ordered by increasing distance
+    std::vector<std::pair<size_t, double>> query_radius(const EmbeddingType& embedding, double max_distance) const {
+        return snapshot()->query_radius(embedding, max_distance);
+    }
+    std::vector<std::pair<size_t, double>> query_radius(const std::vector<float>& embedding, double max_distance) const {
+        return snapshot()->query_radius(embedding, max_distance);
+    }
+
+    // store to file (versioned binary format, see db_file.hpp). Storing over the journaled
+    // file also restarts the journal, every record so far is part of the new snapshot.
+    // Tombstoned slots are compacted first, the file and the rows number their slots alike.
+    bool store(const std::string& filename);
+
+    // load from file, versioned files are memory-mapped and scanned in place.
+    // Records in "<filename>.wal" written since that snapshot are replayed on top.
+    // The header and the layout are always checked, verify_checksum also reads the whole
+    // file to check its CRC, so damaged rows, norms or infos are rejected too. Turn it off
+    // only when startup time on a very large file matters more than that check.
+    bool load(const std::string& filename, bool verify_checksum = true);
+
+    // Log every insert / erase to "<filename>.wal" instead of rewriting the database file,
+    // fsync after every sync_every operations. The journal continues from the snapshot at
+    // filename when the rows still match it, otherwise a new snapshot is written first.
+    bool enable_journal(const std::string& filename, size_t sync_every = 1);
+
+    void disable_journal() {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        journal_.reset();
+    }
+
+    bool journaling() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return journal_ != nullptr;
+    }
 
-    // store to file
-    bool store(const std::string& filename) const;
+    // Size of the journal file, snapshot with checkpoint() once it grows too large
+    uint64_t journal_bytes() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return journal_ ? journal_->bytes() : 0;
+    }
+
+    // Fold the journal into a new snapshot of the journaled file. Should the new snapshot land
+    // but not its journal, the journal is closed and mutations throw until a checkpoint succeeds.
+    bool checkpoint();
 
-    // load from file
-    bool load(const std::string& filename);
+    // Drop tombstoned slots now, live rows keep their order but move to lower indices
+    void compact();
 
-    // Get all embeddings
-    const EmbeddingType& embeddings() const {
-        return embeddings_;
+    // Fraction of erased slots that triggers compaction after an erase
+    void set_compaction_ratio(double ratio) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        compaction_ratio_ = ratio;
     }
 
-    // Get all infos
-    const std::vector<InfoType>& infos() const {
-        return infos_;
+    // Allocate room for at least n slots so the following inserts do not reallocate
+    void reserve(size_t n);
+
+    size_t capacity() const {
+        return snapshot()->capacity();
+    }
+
+    // True while the rows are served straight from a mapped file
+    bool is_mapped() const {
+        return snapshot()->is_mapped();
+    }
+
+    // Answer nearest / top-k queries from an HNSW graph instead of the linear scan.
+    // The graph is stored next to the database file with the ".hnsw" suffix.
+    void enable_hnsw(const HNSWIndex::Params& params = HNSWIndex::Params());
+
+    void disable_hnsw();
+
+    bool hnsw_enabled() const {
+        return snapshot()->graph_ != nullptr;
     }
 
+    // Scan an INT8 / FP16 copy of the rows instead of the fp32 matrix. The best `rerank`
+    // candidates of each scan are rescored in fp32, 0 returns the quantized scores as is.
+    void enable_quantization(QuantizedRows::Mode mode, size_t rerank = 32);
+
+    void disable_quantization();
+
+    // Score galleries of at least min_rows slots on a pool of threads, in shards of about
+    // shard_bytes of fp32 rows so each shard stays in a core's cache. threads counts the
+    // calling thread, 0 uses every core and 1 keeps the single-threaded scan.
+    void enable_parallel_scan(size_t threads, size_t min_rows = 16384, size_t shard_bytes = 256 << 10);
+
+    void disable_parallel_scan();
+
     // Get embedding dimension
     size_t embedding_dim() const {
-        return embedding_dim_;
+        return snapshot()->embedding_dim();
     }
 
-    // Clear database
-    void clear() {
-        embeddings_.resize(0, 0);
-        infos_.clear();
-    }
+    // Clear database, an open journal is closed
+    void clear();
 
-    // Get size (number of embeddings)
+    // Get size (number of live embeddings)
     size_t size() const {
-        return infos_.size();
+        return snapshot()->size();
     }
 
-    // Access embedding and info by index
+    // Number of slots, live or erased. Query results index slots.
+    size_t slots() const {
+        return snapshot()->slots();
+    }
+
+    bool is_erased(size_t idx) const {
+        return snapshot()->is_erased(idx);
+    }
+
+    // Access embedding and info by index in the current snapshot
     EmbeddingType embedding(size_t idx) const {
-        if (embeddings_.rows() == 0) throw std::out_of_range("No embeddings stored");
-        return embeddings_.row(idx);
+        return snapshot()->embedding(idx);
     }
 
-    const InfoType& info(size_t idx) const {
-        return infos_.at(idx);
+    InfoType info(size_t idx) const {
+        return snapshot()->info(idx);
     }
 
 private:
-    // embeddings_ is a matrix of shape N x embeddings_dim, where N is the number of embeddings stored
-    EmbeddingType embeddings_; // Each row is an embedding
-    std::vector<InfoType> infos_;
+    // Rows, norms and infos of up to capacity slots. A slot below the count of a published
+    // snapshot is never written again, the writer only fills the slots above it, so snapshots
+    // share one Storage with the writer. Growth and compaction allocate a new Storage.
+    struct Storage {
+        RowMatrix rows;              // capacity x dim, each row a unit-normalized embedding
+        Eigen::VectorXf norms;       // Original L2 norm of each row
+        std::vector<InfoType> infos; // capacity entries, sized once so elements never move
+        std::shared_ptr<const MappedFile> mapping; // Read-only rows and norms of a loaded file
+        const float* rows_data = nullptr;
+        const float* norms_data = nullptr;
+        size_t capacity = 0;
+    };
+
+    // HNSW graph shared by the writer and the snapshots. Searches hold mutex shared, the writer
+    // holds it exclusively while linking nodes. Compaction replaces it with a graph of the packed
+    // slots, snapshots taken before keep the old one, whose labels still match their slots.
+    struct Graph {
+        Graph(size_t dim, const HNSWIndex::Params& params) : index(dim, params) {}
+
+        // Searches scan instead of queueing on the graph while the writer waits for it, the
+        // reader-preferring shared_mutex would otherwise let a steady query load starve it
+        std::unique_lock<std::shared_mutex> write_lock() {
+            writer_waiting.store(true, std::memory_order_release);
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            writer_waiting.store(false, std::memory_order_release);
+            return lock;
+        }
+
+        mutable std::shared_mutex mutex;
+        std::atomic<bool> writer_waiting = false;
+        HNSWIndex index;
+    };
+
+    // The methods below run with write_mutex_ held
+
+    // Make storage_ an owned Storage with room for n slots, copying into a new one if needed
+    Storage& writable(size_t n);
+
+    // Publish the writer state as the new snapshot
+    void publish();
+
+    void reset();
+
+    bool insert_rows(const EmbeddingType& embeddings, const InfoType* infos);
+
+    // Erase live, sorted, distinct slots as one journaled mutation, compacting when the erased
+    // slots reach compaction_ratio_. A journal failure throws before anything is erased.
+    void erase_slots(const std::vector<size_t>& slots);
+
+    // Mark a live slot erased without moving any row
+    bool tombstone(size_t idx);
+
+    bool is_erased_slot(size_t idx) const {
+        return idx / 64 < erased_.size() && (erased_[idx / 64] >> (idx % 64)) & 1;
+    }
+
+    // Journal a compaction, then run it. compact_rows() alone is what replay runs.
+    void compact_logged();
+    void compact_rows();
+
+    // Normalize owned rows [first, first + count) in place and cache their norms
+    void normalize_rows(size_t first, size_t count);
+
+    // Add rows [first, first + count) to the HNSW graph, labelled by row index
+    void index_rows(size_t first, size_t count);
+
+    // Append rows [first, first + count) to the quantized copy
+    void quantize_rows(size_t first, size_t count);
+
+    bool load_mapped(const std::shared_ptr<const MappedFile>& file, bool verify_checksum);
+    bool load_legacy(const std::string& filename);
+
+    // Write the snapshot file to "<filename>.tmp" and flush it, checksum receives the header
+    // checksum. Nothing refers to it before it is renamed onto filename.
+    bool write_snapshot(const Snapshot& snapshot, const std::string& filename, uint32_t& checksum) const;
+    // Store the graph of the snapshot at filename, once the snapshot is in place
+    bool store_graph(const Snapshot& snapshot, const std::string& filename, uint32_t checksum) const;
+    bool store_locked(const std::string& filename);
+
+    // Append an already normalized row, used by journal replay to reproduce the exact bits
+    void append_normalized(const float* row, float norm, const InfoType& info);
+
+    // Journal records for rows [first, first + count), the erase of a slot and a compaction.
+    // Without a journal a mutation only marks the rows as diverged from the snapshot.
+    void log_insert(size_t first, size_t count);
+    void log_record(DBJournalRecord type, const void* payload, size_t size);
+    void log_commit();
+
+    bool replay_record(DBJournalRecord type, const uint8_t* payload, size_t size);
+
+    std::atomic<std::shared_ptr<const Snapshot>> snapshot_; // What readers see
+
+    // Writer state, guarded by write_mutex_
+    mutable std::mutex write_mutex_;
+    std::shared_ptr<Storage> storage_;
+    size_t slots_ = 0;
+    std::vector<uint64_t> erased_; // Tombstone bitmap, one bit per slot
+    size_t erased_count_ = 0;
+    std::shared_ptr<const std::vector<uint64_t>> published_erased_; // Bitmap of the last snapshot
+    bool erased_changed_ = false;
+    double compaction_ratio_ = 0.25;
+    std::unique_ptr<DBJournal> journal_; // Optional write-ahead log of mutations since the snapshot
+    std::string snapshot_file_;  // Snapshot the rows match (plus the journal), empty once they diverge
+    uint32_t snapshot_checksum_ = 0;
+    bool replaying_ = false;
     size_t embedding_dim_ = 0; // Dimension of each embedding
+    std::shared_ptr<Graph> graph_; // Optional ANN index over the normalized rows
+    std::shared_ptr<QuantizedRows> quantized_; // Optional compact copy of the normalized rows
+    size_t rerank_ = 0; // fp32 rescoring candidates per quantized scan
+    std::shared_ptr<ScanPool> pool_; // Optional threads for sharded scans of large galleries
+    size_t parallel_min_rows_ = 0;
+    size_t shard_bytes_ = 0;
 };
 
 #include "embedding_db_impl.hpp" // Include the implementation file
 
-#endif // __embedding_db_hpp__
\ No newline at end of file
+#endif // __embedding_db_hpp__
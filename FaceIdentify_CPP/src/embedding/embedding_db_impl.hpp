@@ -2,55 +2,43 @@
 template<typename InfoType>
 EmbeddingDB<InfoType>::EmbeddingDB(size_t embedding_dim)
     : embedding_dim_(embedding_dim) {
-    embeddings_.resize(0, embedding_dim_);
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    reset();
+    publish();
 }
 
 
 template<typename InfoType>
 bool EmbeddingDB<InfoType>::insert(const EmbeddingType& embedding, const InfoType& info) {
-    if (embedding.cols() != static_cast<Eigen::Index>(embedding_dim_)) {
-        return false;
-    }
     if (embedding.rows() != 1) {
         return false;
     }
-    // Append embedding
-    Eigen::Index old_rows = embeddings_.rows();
-    embeddings_.conservativeResize(old_rows + 1, embedding_dim_);
-    embeddings_.row(old_rows) = embedding;
-    infos_.push_back(info);
-    return true;
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return insert_rows(embedding, &info);
 }
 
 
 template<typename InfoType>
 bool EmbeddingDB<InfoType>::insert(const EmbeddingType& embeddings, const std::vector<InfoType>& infos) {
-    if (embeddings.cols() != static_cast<Eigen::Index>(embedding_dim_)) {
-        return false;
-    }
     if (static_cast<size_t>(embeddings.rows()) != infos.size()) {
         return false;
     }
-    Eigen::Index old_rows = embeddings_.rows();
-    Eigen::Index new_rows = old_rows + embeddings.rows();
-    embeddings_.conservativeResize(new_rows, embedding_dim_);
-    embeddings_.block(old_rows, 0, embeddings.rows(), embedding_dim_) = embeddings;
-    infos_.insert(infos_.end(), infos.begin(), infos.end());
-    return true;
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return insert_rows(embeddings, infos.data());
 }
 
 
 template<typename InfoType>
 bool EmbeddingDB<InfoType>::insert(const std::vector<float>& embedding, const InfoType& info) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
     if (embedding_dim_ == 0) {
         embedding_dim_ = embedding.size();
-        embeddings_.resize(0, embedding_dim_);
     }
     if (embedding.size() != embedding_dim_) {
         return false;
     }
     Eigen::RowVectorXf emb = Eigen::Map<const Eigen::RowVectorXf>(embedding.data(), embedding_dim_);
-    return insert(emb, info);
+    return insert_rows(emb, &info);
 }
 
 
@@ -60,138 +48,1068 @@ bool EmbeddingDB<InfoType>::insert(const std::vector<std::vector<float>>& embedd
     if (embeddings.size() != infos.size()) {
         return false;
     }
+    std::lock_guard<std::mutex> lock(write_mutex_);
     size_t dim = embeddings[0].size();
     if (embedding_dim_ == 0) {
         embedding_dim_ = dim;
-        embeddings_.resize(0, embedding_dim_);
     }
     if (dim != embedding_dim_) {
         return false;
     }
     Eigen::MatrixXf mat = convert_embeddings_to_matrix(embeddings, embedding_dim_);
-    return insert(mat, infos);
+    return insert_rows(mat, infos.data());
 }
 
 
 template<typename InfoType>
-bool EmbeddingDB<InfoType>::erase(size_t idx) {
-    if (idx >= infos_.size()) return false;
-    // Remove row from embeddings_
-    if (embeddings_.rows() > 1) {
-        Eigen::MatrixXf new_embeddings(embeddings_.rows() - 1, embedding_dim_);
-        if (idx > 0)
-            new_embeddings.topRows(idx) = embeddings_.topRows(idx);
-        if (idx + 1 < static_cast<size_t>(embeddings_.rows()))
-            new_embeddings.bottomRows(embeddings_.rows() - idx - 1) = embeddings_.bottomRows(embeddings_.rows() - idx - 1);
-        embeddings_ = new_embeddings;
-    } else {
-        embeddings_.resize(0, embedding_dim_);
+bool EmbeddingDB<InfoType>::insert_rows(const EmbeddingType& embeddings, const InfoType* infos) {
+    if (embeddings.cols() != static_cast<Eigen::Index>(embedding_dim_)) {
+        return false;
     }
-    infos_.erase(infos_.begin() + idx);
+    // Append behind the published slots, no snapshot reads past its own count
+    size_t first = slots_;
+    size_t count = embeddings.rows();
+    Storage& storage = writable(first + count);
+    storage.rows.middleRows(first, count) = embeddings;
+    std::copy_n(infos, count, storage.infos.begin() + first);
+    normalize_rows(first, count);
+    // Write-ahead: a journal failure throws before the rows are indexed or published
+    log_insert(first, count);
+    log_commit();
+    index_rows(first, count);
+    quantize_rows(first, count);
+    slots_ += count;
+    publish();
+    return true;
+}
+
+
+template<typename InfoType>
+bool EmbeddingDB<InfoType>::erase(size_t idx) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (idx >= slots_ || is_erased_slot(idx)) return false;
+    erase_slots({idx});
     return true;
 }
 
 
 template<typename InfoType>
 bool EmbeddingDB<InfoType>::erase(const InfoType& info) {
-    auto it = std::find(infos_.begin(), infos_.end(), info);
-    if (it == infos_.end()) return false;
-    size_t idx = std::distance(infos_.begin(), it);
-    return erase(idx);
+    return erase(std::vector<InfoType>{info});
 }
 
 
 template<typename InfoType>
 bool EmbeddingDB<InfoType>::erase(const std::vector<InfoType>& infos) {
-    bool result = true;
-    for (const auto& info : infos) {
-        result &= erase(info);
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    const std::vector<InfoType>& slot_infos = storage_->infos;
+    // Collect every match first, each entry erases one slot, then erase them as one mutation
+    std::vector<size_t> matches;
+    if constexpr (requires(const InfoType& x) { std::hash<InfoType>{}(x); }) {
+        // Hashable infos are matched in a single pass over the slots
+        std::unordered_map<InfoType, size_t> pending;
+        for (const auto& info : infos) ++pending[info];
+        for (size_t idx = 0; idx < slots_ && matches.size() < infos.size(); ++idx) {
+            if (is_erased_slot(idx)) continue;
+            auto it = pending.find(slot_infos[idx]);
+            if (it == pending.end() || it->second == 0) continue;
+            --it->second;
+            matches.push_back(idx);
+        }
+    } else {
+        std::vector<uint8_t> taken(slots_, 0);
+        for (const auto& info : infos) {
+            size_t idx = 0;
+            while (idx < slots_ && (taken[idx] || is_erased_slot(idx) || !(slot_infos[idx] == info))) ++idx;
+            if (idx == slots_) continue;
+            taken[idx] = 1;
+            matches.push_back(idx);
+        }
     }
+    const bool result = matches.size() == infos.size();
+    std::sort(matches.begin(), matches.end());
+    erase_slots(matches);
     return result;
 }
 
 
 template<typename InfoType>
 bool EmbeddingDB<InfoType>::erase(const std::vector<size_t>& idxs) {
-    // Remove in reverse order to keep indices valid
-    std::vector<size_t> sorted_idxs = idxs;
-    std::sort(sorted_idxs.rbegin(), sorted_idxs.rend());
-    bool result = true;
-    for (size_t idx : sorted_idxs) {
-        result &= erase(idx);
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    std::vector<size_t> slots;
+    slots.reserve(idxs.size());
+    for (size_t idx : idxs) {
+        if (idx < slots_ && !is_erased_slot(idx)) slots.push_back(idx);
     }
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+    // Out of range, already erased and repeated indices all make the result false
+    const bool result = slots.size() == idxs.size();
+    erase_slots(slots);
     return result;
 }
 
 
 template<typename InfoType>
-std::pair<size_t, double> EmbeddingDB<InfoType>::query_nearest(const EmbeddingType& embedding) const {
-    if (embeddings_.rows() == 0) throw std::runtime_error("No embeddings in database.");
-    if (embedding.cols() != static_cast<Eigen::Index>(embedding_dim_)) {
+void EmbeddingDB<InfoType>::erase_slots(const std::vector<size_t>& slots) {
+    if (slots.empty()) return;
+    // Decided before anything changes so the journal can say it ahead of the mutation
+    const bool compact = erased_count_ + slots.size() >= compaction_ratio_ * slots_;
+    for (size_t idx : slots) {
+        uint64_t slot = idx;
+        log_record(DBJournalRecord::ERASE, &slot, sizeof(slot));
+    }
+    if (compact) log_record(DBJournalRecord::COMPACT, "", 0);
+    // Write-ahead: a journal failure throws before any slot is erased
+    log_commit();
+    for (size_t idx : slots) {
+        tombstone(idx);
+    }
+    if (compact) compact_rows();
+    publish();
+}
+
+
+template<typename InfoType>
+std::pair<size_t, double> EmbeddingDB<InfoType>::Snapshot::query_nearest(const EmbeddingType& embedding) const {
+    if (embedding.cols() != static_cast<Eigen::Index>(dim_)) {
         throw std::invalid_argument("Embedding dimension mismatch.");
     }
-    Eigen::VectorXf query_vec = embedding.row(0);
-    Eigen::VectorXf dot_products = embeddings_ * query_vec;
-    Eigen::VectorXf db_norms = embeddings_.rowwise().norm();
-    float query_norm = query_vec.norm() + 1e-6f;
-    Eigen::VectorXf cosine_similarities = dot_products.array() / (db_norms.array() * query_norm);
-    Eigen::VectorXf cosine_distances = 1.0f - cosine_similarities.array();
-    Eigen::Index min_idx;
-    float min_dist = cosine_distances.minCoeff(&min_idx);
-    return {static_cast<size_t>(min_idx), static_cast<double>(min_dist)};
+    return nearest(embedding.row(0));
 }
 
 template<typename InfoType>
-std::pair<size_t, double> EmbeddingDB<InfoType>::query_nearest(const std::vector<float>& embedding) const {
-    if (embedding.size() != embedding_dim_) {
+std::pair<size_t, double> EmbeddingDB<InfoType>::Snapshot::query_nearest(const std::vector<float>& embedding) const {
+    if (embedding.size() != dim_) {
         throw std::invalid_argument("Embedding dimension mismatch.");
     }
-    Eigen::RowVectorXf emb = Eigen::Map<const Eigen::RowVectorXf>(embedding.data(), embedding_dim_);
-    
-    return query_nearest(emb);
+    return nearest(Eigen::Map<const Eigen::RowVectorXf>(embedding.data(), dim_));
 }
 
 template<typename InfoType>
-bool EmbeddingDB<InfoType>::store(const std::string& filename) const {
-    std::ofstream ofs(filename, std::ios::binary);
-    if (!ofs) return false;
-    // Write embedding_dim_ and number of embeddings
-    size_t n = size();
-    ofs.write(reinterpret_cast<const char*>(&embedding_dim_), sizeof(embedding_dim_));
-    ofs.write(reinterpret_cast<const char*>(&n), sizeof(n));
-    // Write embeddings
-    if (n > 0) {
-        ofs.write(reinterpret_cast<const char*>(embeddings_.data()), sizeof(float) * n * embedding_dim_);
+std::vector<std::pair<size_t, double>> EmbeddingDB<InfoType>::Snapshot::query_nearest_batch(const EmbeddingType& queries) const {
+    if (size() == 0) throw std::runtime_error("No embeddings in database.");
+    if (queries.cols() != static_cast<Eigen::Index>(dim_)) {
+        throw std::invalid_argument("Embedding dimension mismatch.");
+    }
+    if (graph_ || quantized_) {
+        std::vector<std::pair<size_t, double>> results(queries.rows());
+        for (Eigen::Index k = 0; k < queries.rows(); ++k) {
+            results[k] = nearest(queries.row(k));
+        }
+        return results;
+    }
+    // Per shard N x K scores, so the argmax for each query runs over a contiguous column.
+    // Shard s leaves the best row of query k in best[s * K + k].
+    const size_t shards = this->shards();
+    const Eigen::Index K = queries.rows();
+    std::vector<std::pair<float, size_t>> best(shards * K);
+    auto scan = [&](size_t s) {
+        auto [first, count] = shards == 1 ? std::pair<size_t, size_t>{0, slots_} : shard_range(s);
+        thread_local Eigen::MatrixXf scores;
+        scores.noalias() = embeddings().middleRows(first, count) * queries.transpose();
+        for (size_t idx = first; idx < first + count && erased_count_ > 0; ++idx) {
+            if (is_erased(idx)) scores.row(idx - first).setConstant(-std::numeric_limits<float>::infinity());
+        }
+        for (Eigen::Index k = 0; k < K; ++k) {
+            Eigen::Index max_idx;
+            float max_dot = scores.col(k).maxCoeff(&max_idx);
+            best[s * K + k] = {max_dot, first + static_cast<size_t>(max_idx)};
+        }
+    };
+    if (shards == 1) {
+        scan(0);
+    } else {
+        pool_->run(shards, scan);
+    }
+
+    std::vector<std::pair<size_t, double>> results(K);
+    for (Eigen::Index k = 0; k < K; ++k) {
+        float query_norm = queries.row(k).norm() + 1e-6f;
+        std::pair<float, size_t> max = best[k];
+        for (size_t s = 1; s < shards; ++s) {
+            if (best[s * K + k].first > max.first) max = best[s * K + k];
+        }
+        results[k] = {max.second, 1.0 - static_cast<double>(max.first / query_norm)};
+    }
+    return results;
+}
+
+template<typename InfoType>
+std::vector<std::pair<size_t, double>> EmbeddingDB<InfoType>::Snapshot::query_topk(const EmbeddingType& embedding, size_t k) const {
+    if (embedding.cols() != static_cast<Eigen::Index>(dim_)) {
+        throw std::invalid_argument("Embedding dimension mismatch.");
+    }
+    return topk(embedding.row(0), k);
+}
+
+template<typename InfoType>
+std::vector<std::pair<size_t, double>> EmbeddingDB<InfoType>::Snapshot::query_topk(const std::vector<float>& embedding, size_t k) const {
+    if (embedding.size() != dim_) {
+        throw std::invalid_argument("Embedding dimension mismatch.");
+    }
+    return topk(Eigen::Map<const Eigen::RowVectorXf>(embedding.data(), dim_), k);
+}
+
+template<typename InfoType>
+std::vector<std::pair<size_t, double>> EmbeddingDB<InfoType>::Snapshot::query_radius(const EmbeddingType& embedding, double max_distance) const {
+    if (embedding.cols() != static_cast<Eigen::Index>(dim_)) {
+        throw std::invalid_argument("Embedding dimension mismatch.");
+    }
+    return radius(embedding.row(0), max_distance);
+}
+
+template<typename InfoType>
+std::vector<std::pair<size_t, double>> EmbeddingDB<InfoType>::Snapshot::query_radius(const std::vector<float>& embedding, double max_distance) const {
+    if (embedding.size() != dim_) {
+        throw std::invalid_argument("Embedding dimension mismatch.");
+    }
+    return radius(Eigen::Map<const Eigen::RowVectorXf>(embedding.data(), dim_), max_distance);
+}
+
+template<typename InfoType>
+const Eigen::VectorXf& EmbeddingDB<InfoType>::Snapshot::scores(const QueryRow& query) const {
+    if (size() == 0) throw std::runtime_error("No embeddings in database.");
+    // Rows are stored unit-normalized, so the cosine similarity is one GEMV scaled by the query norm.
+    // The score buffer is reused across calls on the same thread to keep the lookup allocation-free.
+    thread_local Eigen::VectorXf buffer;
+    buffer.noalias() = embeddings() * query.transpose();
+    mask_erased(buffer);
+    return buffer;
+}
+
+template<typename InfoType>
+const Eigen::VectorXf& EmbeddingDB<InfoType>::Snapshot::approx_scores(const QueryRow& query) const {
+    if (!quantized_) return scores(query);
+    if (size() == 0) throw std::runtime_error("No embeddings in database.");
+    thread_local Eigen::RowVectorXf contiguous;
+    thread_local Eigen::VectorXf buffer;
+    contiguous = query;
+    // The writer may already be appending past this snapshot, scan only its own slots
+    buffer.resize(slots_);
+    quantized_->scores(contiguous.data(), buffer.data(), 0, slots_);
+    mask_erased(buffer);
+    return buffer;
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::Snapshot::shard_scores(const Eigen::RowVectorXf& query, size_t first, size_t count,
+                                                   bool approx, float* out) const {
+    if (approx && quantized_) {
+        quantized_->scores(query.data(), out, first, count);
+    } else {
+        Eigen::Map<Eigen::VectorXf>(out, count).noalias() = embeddings().middleRows(first, count) * query.transpose();
+    }
+    for (size_t idx = first; idx < first + count && erased_count_ > 0; ++idx) {
+        if (is_erased(idx)) out[idx - first] = -std::numeric_limits<float>::infinity();
+    }
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::Snapshot::select_topk(std::vector<std::pair<float, size_t>>& heap, size_t k,
+                                                  const float* dots, size_t first, size_t count) {
+    // Min-heap on the dot product holding the k best rows seen so far; the full score
+    // vector is never sorted, only the k survivors are.
+    auto greater = [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) {
+        return a.first > b.first;
+    };
+    for (size_t i = 0; i < count; ++i) {
+        if (heap.size() < k) {
+            heap.emplace_back(dots[i], first + i);
+            std::push_heap(heap.begin(), heap.end(), greater);
+        } else if (dots[i] > heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end(), greater);
+            heap.back() = {dots[i], first + i};
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+    }
+}
+
+template<typename InfoType>
+std::pair<size_t, double> EmbeddingDB<InfoType>::Snapshot::nearest(const QueryRow& query) const {
+    if (graph_ || quantized_) {
+        auto results = topk(query, 1);
+        if (results.empty()) throw std::runtime_error("No embeddings in database.");
+        return results.front();
+    }
+    float query_norm = query.norm() + 1e-6f;
+    const size_t shards = this->shards();
+    if (shards == 1) {
+        const Eigen::VectorXf& dots = scores(query);
+        Eigen::Index max_idx;
+        float max_dot = dots.maxCoeff(&max_idx);
+        return {static_cast<size_t>(max_idx), 1.0 - static_cast<double>(max_dot / query_norm)};
+    }
+
+    // Best row of every shard, then the best of those. Workers see their own thread_local
+    // objects, they get the query through a plain reference.
+    thread_local Eigen::RowVectorXf query_buffer;
+    query_buffer = query;
+    const Eigen::RowVectorXf& contiguous = query_buffer;
+    std::vector<std::pair<float, size_t>> best(shards);
+    pool_->run(shards, [&](size_t s) {
+        auto [first, count] = shard_range(s);
+        thread_local Eigen::VectorXf dots;
+        dots.resize(count);
+        shard_scores(contiguous, first, count, false, dots.data());
+        Eigen::Index max_idx;
+        float max_dot = dots.maxCoeff(&max_idx);
+        best[s] = {max_dot, first + static_cast<size_t>(max_idx)};
+    });
+    auto max = *std::max_element(best.begin(), best.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+    return {max.second, 1.0 - static_cast<double>(max.first / query_norm)};
+}
+
+template<typename InfoType>
+std::vector<std::pair<size_t, double>> EmbeddingDB<InfoType>::Snapshot::topk(const QueryRow& query, size_t k) const {
+    float query_norm = query.norm() + 1e-6f;
+    if (size() == 0) throw std::runtime_error("No embeddings in database.");
+    if (graph_ && !graph_->writer_waiting.load(std::memory_order_acquire)) {
+        std::shared_lock<std::shared_mutex> lock(graph_->mutex);
+        thread_local Eigen::RowVectorXf contiguous;
+        contiguous = query;
+        std::vector<std::pair<size_t, double>> results;
+        bool filtered = false;
+        for (const auto& [idx, dot] : graph_->index.search(contiguous.data(), k)) {
+            // Nodes linked after this snapshot are not part of it
+            if (idx >= slots_ || is_erased(idx)) {
+                filtered = true;
+                continue;
+            }
+            results.emplace_back(idx, 1.0 - static_cast<double>(dot / query_norm));
+        }
+        // Newer nodes took some of the k places, the scan below answers for this snapshot
+        if (!filtered || results.size() >= std::min(k, size())) return results;
+    }
+
+    // Erased slots score -inf, so with k <= size() they never reach the heap
+    k = std::min(k, size());
+    if (k == 0) return {};
+    // Quantized scans keep a wider candidate set that is rescored in fp32 below
+    bool rerank = quantized_ && rerank_ > 0;
+    size_t k_final = k;
+    if (rerank) k = std::min(std::max(k, rerank_), size());
+
+    std::vector<std::pair<float, size_t>> heap;
+    heap.reserve(k);
+    const size_t shards = this->shards();
+    if (shards == 1) {
+        const Eigen::VectorXf& dots = approx_scores(query);
+        select_topk(heap, k, dots.data(), 0, dots.size());
+    } else {
+        // k best of every shard, merged into the k best overall
+        thread_local Eigen::RowVectorXf query_buffer;
+        query_buffer = query;
+        const Eigen::RowVectorXf& contiguous = query_buffer;
+        std::vector<std::vector<std::pair<float, size_t>>> shard_heaps(shards);
+        pool_->run(shards, [&](size_t s) {
+            auto [first, count] = shard_range(s);
+            thread_local std::vector<float> dots;
+            dots.resize(count);
+            shard_scores(contiguous, first, count, true, dots.data());
+            shard_heaps[s].reserve(k);
+            select_topk(shard_heaps[s], k, dots.data(), first, count);
+        });
+        for (const auto& shard_heap : shard_heaps) {
+            for (const auto& [dot, idx] : shard_heap) {
+                select_topk(heap, k, &dot, idx, 1);
+            }
+        }
+    }
+    auto greater = [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) {
+        return a.first > b.first;
+    };
+    if (rerank) {
+        for (auto& [dot, idx] : heap) {
+            dot = embeddings().row(idx).dot(query);
+        }
+    }
+    std::sort(heap.begin(), heap.end(), greater);
+    if (heap.size() > k_final) heap.resize(k_final);
+
+    std::vector<std::pair<size_t, double>> results;
+    results.reserve(k_final);
+    for (const auto& [dot, idx] : heap) {
+        results.emplace_back(idx, 1.0 - static_cast<double>(dot / query_norm));
+    }
+    return results;
+}
+
+template<typename InfoType>
+std::vector<std::pair<size_t, double>> EmbeddingDB<InfoType>::Snapshot::radius(const QueryRow& query, double max_distance) const {
+    float query_norm = query.norm() + 1e-6f;
+    // distance <= max_distance  <=>  dot >= (1 - max_distance) * query_norm
+    float min_dot = static_cast<float>(1.0 - max_distance) * query_norm;
+
+    std::vector<std::pair<size_t, double>> results;
+    const size_t shards = this->shards();
+    if (shards == 1) {
+        const Eigen::VectorXf& dots = scores(query);
+        for (Eigen::Index i = 0; i < dots.size(); ++i) {
+            if (dots(i) >= min_dot) {
+                results.emplace_back(static_cast<size_t>(i), 1.0 - static_cast<double>(dots(i) / query_norm));
+            }
+        }
+    } else {
+        if (size() == 0) throw std::runtime_error("No embeddings in database.");
+        thread_local Eigen::RowVectorXf query_buffer;
+        query_buffer = query;
+        const Eigen::RowVectorXf& contiguous = query_buffer;
+        std::vector<std::vector<std::pair<size_t, double>>> shard_results(shards);
+        pool_->run(shards, [&](size_t s) {
+            auto [first, count] = shard_range(s);
+            thread_local std::vector<float> dots;
+            dots.resize(count);
+            shard_scores(contiguous, first, count, false, dots.data());
+            for (size_t i = 0; i < count; ++i) {
+                if (dots[i] >= min_dot) {
+                    shard_results[s].emplace_back(first + i, 1.0 - static_cast<double>(dots[i] / query_norm));
+                }
+            }
+        });
+        for (const auto& shard_result : shard_results) {
+            results.insert(results.end(), shard_result.begin(), shard_result.end());
+        }
+    }
+    std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+        return a.second < b.second;
+    });
+    return results;
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::enable_hnsw(const HNSWIndex::Params& params) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (embedding_dim_ == 0) throw std::logic_error("EmbeddingDB dimension must be set before enabling HNSW.");
+    // Built aside and published once complete, readers keep the previous search path meanwhile
+    graph_ = std::make_shared<Graph>(embedding_dim_, params);
+    index_rows(0, slots_);
+    for (size_t w = 0; w < erased_.size(); ++w) {
+        for (uint64_t bits = erased_[w]; bits; bits &= bits - 1) {
+            graph_->index.erase(w * 64 + std::countr_zero(bits));
+        }
+    }
+    publish();
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::disable_hnsw() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    graph_.reset();
+    publish();
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::enable_quantization(QuantizedRows::Mode mode, size_t rerank) {
+    if (mode == QuantizedRows::Mode::NONE) {
+        disable_quantization();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (embedding_dim_ == 0) throw std::logic_error("EmbeddingDB dimension must be set before enabling quantization.");
+    quantized_ = std::make_shared<QuantizedRows>(embedding_dim_, mode, storage_->capacity);
+    rerank_ = rerank;
+    quantize_rows(0, slots_);
+    publish();
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::disable_quantization() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    quantized_.reset();
+    publish();
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::enable_parallel_scan(size_t threads, size_t min_rows, size_t shard_bytes) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads <= 1) {
+        disable_parallel_scan();
+        return;
+    }
+    auto pool = std::make_shared<ScanPool>(threads);
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    pool_ = std::move(pool);
+    parallel_min_rows_ = std::max<size_t>(min_rows, 1);
+    shard_bytes_ = shard_bytes;
+    publish();
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::disable_parallel_scan() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    pool_.reset();
+    publish();
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::quantize_rows(size_t first, size_t count) {
+    if (!quantized_) return;
+    for (size_t i = first; i < first + count; ++i) {
+        quantized_->append(storage_->rows_data + i * embedding_dim_);
+    }
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::index_rows(size_t first, size_t count) {
+    if (!graph_ || count == 0) return;
+    auto lock = graph_->write_lock();
+    for (size_t i = first; i < first + count; ++i) {
+        graph_->index.insert(i, storage_->rows_data + i * embedding_dim_);
+    }
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::normalize_rows(size_t first, size_t count) {
+    for (size_t i = first; i < first + count; ++i) {
+        float norm = storage_->rows.row(i).norm();
+        storage_->norms(i) = norm;
+        if (norm > 0.0f) storage_->rows.row(i) /= norm;
+    }
+}
+
+template<typename InfoType>
+typename EmbeddingDB<InfoType>::Storage& EmbeddingDB<InfoType>::writable(size_t n) {
+    const Storage& current = *storage_;
+    if (!current.mapping && n <= current.capacity && current.rows.cols() == static_cast<Eigen::Index>(embedding_dim_)) {
+        return *storage_;
+    }
+    // Grow geometrically into a new Storage, published snapshots keep reading the old one
+    size_t capacity = std::max<size_t>({n, current.capacity * 2, 16});
+    auto grown = std::make_shared<Storage>();
+    grown->rows.resize(capacity, embedding_dim_);
+    grown->norms.resize(capacity);
+    grown->infos.resize(capacity);
+    grown->capacity = capacity;
+    if (slots_ > 0) {
+        std::memcpy(grown->rows.data(), current.rows_data, sizeof(float) * slots_ * embedding_dim_);
+        std::memcpy(grown->norms.data(), current.norms_data, sizeof(float) * slots_);
+        std::copy_n(current.infos.begin(), slots_, grown->infos.begin());
+    }
+    grown->rows_data = grown->rows.data();
+    grown->norms_data = grown->norms.data();
+    storage_ = grown;
+    if (quantized_ && quantized_->capacity() < capacity) {
+        quantized_ = std::make_shared<QuantizedRows>(*quantized_, capacity);
+    }
+    return *storage_;
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::publish() {
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->storage_ = storage_;
+    snapshot->quantized_ = quantized_;
+    snapshot->graph_ = graph_;
+    // The bitmap is copied once per mutation that changed it, inserts share the previous copy
+    if (erased_changed_) {
+        published_erased_ = erased_count_ > 0 ? std::make_shared<const std::vector<uint64_t>>(erased_) : nullptr;
+        erased_changed_ = false;
+    }
+    snapshot->erased_ = published_erased_;
+    snapshot->erased_count_ = erased_count_;
+    snapshot->slots_ = slots_;
+    snapshot->dim_ = embedding_dim_;
+    snapshot->rerank_ = rerank_;
+    snapshot->pool_ = pool_;
+    snapshot->parallel_min_rows_ = parallel_min_rows_;
+    // At least 64 rows per shard, so a small dimension does not split the scan into tiny tasks
+    snapshot->shard_rows_ = std::max<size_t>(shard_bytes_ / (sizeof(float) * std::max<size_t>(embedding_dim_, 1)), 64);
+    snapshot_.store(std::move(snapshot), std::memory_order_release);
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::reset() {
+    journal_.reset();
+    snapshot_file_.clear();
+    storage_ = std::make_shared<Storage>();
+    storage_->rows.resize(0, embedding_dim_);
+    slots_ = 0;
+    erased_.clear();
+    erased_count_ = 0;
+    erased_changed_ = true;
+    if (graph_) graph_ = std::make_shared<Graph>(embedding_dim_, graph_->index.params());
+    if (quantized_) quantized_ = std::make_shared<QuantizedRows>(embedding_dim_, quantized_->mode());
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::clear() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    reset();
+    publish();
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::reserve(size_t n) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    writable(n);
+    publish();
+}
+
+template<typename InfoType>
+bool EmbeddingDB<InfoType>::tombstone(size_t idx) {
+    if (idx >= slots_ || is_erased_slot(idx)) return false;
+    if (erased_.size() <= idx / 64) erased_.resize(slots_ / 64 + 1, 0);
+    erased_[idx / 64] |= uint64_t{1} << (idx % 64);
+    ++erased_count_;
+    erased_changed_ = true;
+    if (graph_) {
+        auto lock = graph_->write_lock();
+        graph_->index.erase(idx);
+    }
+    return true;
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::compact() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    compact_logged();
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::compact_logged() {
+    if (erased_count_ == 0) return;
+    log_record(DBJournalRecord::COMPACT, "", 0);
+    log_commit();
+    compact_rows();
+    publish();
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::compact_rows() {
+    if (erased_count_ == 0) return;
+    // Copy the live rows into a new Storage in one pass, published snapshots keep the old one
+    const Storage& current = *storage_;
+    size_t capacity = std::max<size_t>(current.capacity, 16);
+    auto packed = std::make_shared<Storage>();
+    packed->rows.resize(capacity, embedding_dim_);
+    packed->norms.resize(capacity);
+    packed->infos.resize(capacity);
+    packed->capacity = capacity;
+    size_t live = 0;
+    for (size_t i = 0; i < slots_; ++i) {
+        if (is_erased_slot(i)) continue;
+        std::memcpy(packed->rows.row(live).data(), current.rows_data + i * embedding_dim_, sizeof(float) * embedding_dim_);
+        packed->norms(live) = current.norms_data[i];
+        packed->infos[live++] = current.infos[i];
+    }
+    packed->rows_data = packed->rows.data();
+    packed->norms_data = packed->norms.data();
+    storage_ = packed;
+    slots_ = live;
+    erased_.clear();
+    erased_count_ = 0;
+    erased_changed_ = true;
+    // Rebuilt rather than relabelled, so the tombstoned nodes are dropped with their rows
+    if (graph_) {
+        graph_ = std::make_shared<Graph>(embedding_dim_, graph_->index.params());
+        index_rows(0, live);
     }
-    // Write infos
-    for (const auto& info : infos_) {
-        ofs << info << '\n';
+    if (quantized_) {
+        quantized_ = std::make_shared<QuantizedRows>(embedding_dim_, quantized_->mode(), capacity);
+        quantize_rows(0, live);
     }
-    return ofs.good();
 }
 
 template<typename InfoType>
-bool EmbeddingDB<InfoType>::load(const std::string& filename) {
+bool EmbeddingDB<InfoType>::store(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return store_locked(filename);
+}
+
+template<typename InfoType>
+bool EmbeddingDB<InfoType>::checkpoint() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return journal_ && store_locked(snapshot_file_);
+}
+
+template<typename InfoType>
+bool EmbeddingDB<InfoType>::store_locked(const std::string& filename) {
+    // The file holds live rows only, so the rows are compacted first: a journal continuing
+    // from the file must number its slots the way the file does
+    compact_logged();
+    // Every mutation publishes before releasing the writer mutex, so the current snapshot is the writer state
+    const std::shared_ptr<const Snapshot> current = snapshot();
+    const std::string tmp_filename = filename + ".tmp";
+    uint32_t checksum = 0;
+    if (!write_snapshot(*current, filename, checksum)) return false;
+
+    // A copy elsewhere leaves the journal alone
+    if (!journal_ || filename != snapshot_file_) {
+        if (!db_file_replace(tmp_filename, filename)) return false;
+        if (!journal_) {
+            snapshot_file_ = filename;
+            snapshot_checksum_ = checksum;
+        }
+        return store_graph(*current, filename, checksum);
+    }
+
+    // The journaled file and its journal are replaced together: the empty journal of the new
+    // snapshot is durable before the snapshot is renamed into place, and takes the place of the
+    // old journal right after. A crash in between leaves the new snapshot with the old journal,
+    // whose records it already holds and which load() ignores.
+    if (!journal_->prepare_restart(checksum)) {
+        std::remove(tmp_filename.c_str());
+        return false;
+    }
+    if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        journal_->cancel_restart();
+        std::remove(tmp_filename.c_str());
+        return false;
+    }
+    snapshot_checksum_ = checksum;
+    // Same directory, syncing it makes both renames durable. Should it fail, the journal is
+    // closed and mutations fail rather than being logged where load() would not replay them.
+    if (!journal_->finish_restart()) return false;
+    return store_graph(*current, filename, checksum);
+}
+
+template<typename InfoType>
+bool EmbeddingDB<InfoType>::write_snapshot(const Snapshot& snapshot, const std::string& filename, uint32_t& checksum) const {
+    // Only live slots are written, the file is always compact
+    const size_t n = snapshot.size();
+    const size_t dim = snapshot.embedding_dim();
+    const float* rows = snapshot.embeddings().data();
+    const float* norms = snapshot.norms().data();
+
+    // Serialize the infos into one text blob indexed by offsets
+    std::vector<uint64_t> info_offsets(n + 1, 0);
+    std::string info_blob;
+    for (size_t i = 0, j = 0; i < snapshot.slots(); ++i) {
+        if (snapshot.is_erased(i)) continue;
+        std::ostringstream oss;
+        oss << snapshot.infos()[i];
+        info_blob += oss.str();
+        info_offsets[++j] = info_blob.size();
+    }
+
+    DBFileHeader header{};
+    std::memcpy(header.magic, DB_FILE_MAGIC, sizeof(header.magic));
+    header.version = DB_FILE_VERSION;
+    header.byte_order = DB_FILE_BYTE_ORDER;
+    header.dim = dim;
+    header.count = n;
+    header.rows_offset = db_file_align(sizeof(DBFileHeader));
+    header.norms_offset = db_file_align(header.rows_offset + sizeof(float) * n * dim);
+    header.infos_offset = db_file_align(header.norms_offset + sizeof(float) * n);
+    header.file_size = header.infos_offset + sizeof(uint64_t) * (n + 1) + info_blob.size();
+
+    // Written to a temporary file the caller renames over the old one, so a crash never leaves
+    // a half-written database and processes that still map the old file keep a valid view
+    const std::string tmp_filename = filename + ".tmp";
+    {
+        std::ofstream ofs(tmp_filename, std::ios::binary | std::ios::trunc);
+        if (!ofs) return false;
+
+        uint32_t crc = 0;
+        uint64_t offset = 0;
+        const char zeros[DB_FILE_ALIGNMENT] = {};
+        auto write = [&](const void* data, size_t bytes) {
+            ofs.write(static_cast<const char*>(data), bytes);
+            crc = db_file_crc32(data, bytes, crc);
+            offset += bytes;
+        };
+        auto pad_to = [&](uint64_t target) {
+            write(zeros, target - offset);
+        };
+
+        write(&header, sizeof(header)); // checksums are zero until patched below
+        pad_to(header.rows_offset);
+        if (n == snapshot.slots()) {
+            write(rows, sizeof(float) * n * dim);
+            pad_to(header.norms_offset);
+            write(norms, sizeof(float) * n);
+        } else {
+            for (size_t i = 0; i < snapshot.slots(); ++i) {
+                if (!snapshot.is_erased(i)) write(rows + i * dim, sizeof(float) * dim);
+            }
+            pad_to(header.norms_offset);
+            for (size_t i = 0; i < snapshot.slots(); ++i) {
+                if (!snapshot.is_erased(i)) write(norms + i, sizeof(float));
+            }
+        }
+        pad_to(header.infos_offset);
+        write(info_offsets.data(), sizeof(uint64_t) * info_offsets.size());
+        write(info_blob.data(), info_blob.size());
+
+        header.checksum = crc;
+        header.header_checksum = db_file_header_crc32(header);
+        ofs.seekp(0);
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.flush();
+        if (!ofs.good()) return false;
+    }
+    checksum = header.checksum;
+    // Durable before anything refers to it
+    if (!db_file_sync(tmp_filename)) {
+        std::remove(tmp_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+template<typename InfoType>
+bool EmbeddingDB<InfoType>::store_graph(const Snapshot& snapshot, const std::string& filename, uint32_t checksum) const {
+    if (!snapshot.graph_) return true;
+    if (snapshot.size() != snapshot.slots()) {
+        // Graph labels are slot indices that no longer match the compacted file, load() rebuilds it
+        std::remove((filename + ".hnsw").c_str());
+        return true;
+    }
+    std::shared_lock<std::shared_mutex> graph_lock(snapshot.graph_->mutex);
+    return snapshot.graph_->index.store(filename + ".hnsw", checksum);
+}
+
+template<typename InfoType>
+bool EmbeddingDB<InfoType>::load(const std::string& filename, bool verify_checksum) {
+    std::shared_ptr<const MappedFile> file = MappedFile::open(filename);
+    if (!file) return false;
+    // Readers keep the previous snapshot until the loaded one is published
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    reset();
+
+    bool ok;
+    bool versioned = file->size() >= sizeof(DBFileHeader) &&
+                     std::memcmp(file->data(), DB_FILE_MAGIC, sizeof(DB_FILE_MAGIC)) == 0;
+    if (versioned) {
+        ok = load_mapped(file, verify_checksum);
+    } else {
+        file.reset();
+        ok = load_legacy(filename);
+    }
+    if (!ok) {
+        reset();
+        publish();
+        return false;
+    }
+
+    const size_t n = slots_;
+    if (quantized_) {
+        quantized_ = std::make_shared<QuantizedRows>(embedding_dim_, quantized_->mode(), storage_->capacity);
+        quantize_rows(0, n);
+    }
+    if (graph_) {
+        // Reuse the persisted graph when it was built from these rows, otherwise rebuild it.
+        // Legacy files have no checksum to match a graph against.
+        graph_ = std::make_shared<Graph>(embedding_dim_, graph_->index.params());
+        if (!versioned || !graph_->index.load(filename + ".hnsw", snapshot_checksum_) ||
+            graph_->index.size() != n) {
+            graph_->index.clear();
+            index_rows(0, n);
+        }
+    }
+
+    // Legacy files have no checksum for a journal to refer to, enable_journal() rewrites them
+    if (versioned) {
+        bool replayed = true;
+        replaying_ = true;
+        try {
+            DBJournal::replay(filename + ".wal", embedding_dim_, snapshot_checksum_,
+                              [&](DBJournalRecord type, const uint8_t* payload, size_t size) {
+                                  replayed = replay_record(type, payload, size);
+                                  return replayed;
+                              });
+        } catch (...) {
+            replaying_ = false;
+            throw;
+        }
+        replaying_ = false;
+        // A rejected record leaves the journal unusable, the next enable_journal() starts a new snapshot
+        if (replayed) snapshot_file_ = filename;
+    }
+    publish();
+    return true;
+}
+
+template<typename InfoType>
+bool EmbeddingDB<InfoType>::enable_journal(const std::string& filename, size_t sync_every) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (embedding_dim_ == 0) throw std::logic_error("EmbeddingDB dimension must be set before enabling the journal.");
+    journal_.reset();
+    const std::string journal_file = filename + ".wal";
+    if (snapshot_file_ == filename) {
+        journal_ = DBJournal::open(journal_file, embedding_dim_, snapshot_checksum_, sync_every);
+        if (!journal_) journal_ = DBJournal::create(journal_file, embedding_dim_, snapshot_checksum_, sync_every);
+        return journal_ != nullptr;
+    }
+    // The rows no longer match the file, start from a fresh snapshot, compacted like the file
+    compact_logged();
+    const std::shared_ptr<const Snapshot> current = snapshot();
+    const std::string tmp_filename = filename + ".tmp";
+    uint32_t checksum = 0;
+    if (!write_snapshot(*current, filename, checksum)) return false;
+    if (!db_file_replace(tmp_filename, filename)) return false;
+    snapshot_file_ = filename;
+    snapshot_checksum_ = checksum;
+    // A graph that cannot be stored only costs a rebuild on load(), the journal is what matters
+    store_graph(*current, filename, checksum);
+    journal_ = DBJournal::create(journal_file, embedding_dim_, checksum, sync_every);
+    return journal_ != nullptr;
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::append_normalized(const float* row, float norm, const InfoType& info) {
+    size_t slot = slots_;
+    Storage& storage = writable(slot + 1);
+    storage.rows.row(slot) = Eigen::Map<const Eigen::RowVectorXf>(row, embedding_dim_);
+    storage.norms(slot) = norm;
+    storage.infos[slot] = info;
+    index_rows(slot, 1);
+    quantize_rows(slot, 1);
+    ++slots_;
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::log_insert(size_t first, size_t count) {
+    if (replaying_) return;
+    if (!journal_) {
+        snapshot_file_.clear();
+        return;
+    }
+    std::string payload;
+    for (size_t i = first; i < first + count; ++i) {
+        std::ostringstream oss;
+        oss << storage_->infos[i];
+        const std::string info = oss.str();
+        payload.resize(sizeof(float) * (1 + embedding_dim_));
+        std::memcpy(payload.data(), storage_->norms_data + i, sizeof(float));
+        std::memcpy(payload.data() + sizeof(float), storage_->rows_data + i * embedding_dim_, sizeof(float) * embedding_dim_);
+        payload += info;
+        journal_->append(DBJournalRecord::INSERT, payload.data(), payload.size());
+    }
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::log_record(DBJournalRecord type, const void* payload, size_t size) {
+    if (replaying_) return;
+    if (journal_) {
+        journal_->append(type, payload, size);
+    } else {
+        snapshot_file_.clear();
+    }
+}
+
+template<typename InfoType>
+void EmbeddingDB<InfoType>::log_commit() {
+    if (journal_ && !journal_->commit()) {
+        throw std::runtime_error("Failed to write the EmbeddingDB journal " + journal_->filename());
+    }
+}
+
+template<typename InfoType>
+bool EmbeddingDB<InfoType>::replay_record(DBJournalRecord type, const uint8_t* payload, size_t size) {
+    switch (type) {
+        case DBJournalRecord::INSERT: {
+            const size_t row_bytes = sizeof(float) * (1 + embedding_dim_);
+            if (size < row_bytes) return false;
+            float norm;
+            std::memcpy(&norm, payload, sizeof(float));
+            std::vector<float> row(embedding_dim_);
+            std::memcpy(row.data(), payload + sizeof(float), sizeof(float) * embedding_dim_);
+            InfoType info;
+            std::istringstream iss(std::string(reinterpret_cast<const char*>(payload) + row_bytes, size - row_bytes));
+            iss >> info;
+            append_normalized(row.data(), norm, info);
+            return true;
+        }
+        case DBJournalRecord::ERASE: {
+            uint64_t slot;
+            if (size != sizeof(slot)) return false;
+            std::memcpy(&slot, payload, sizeof(slot));
+            return tombstone(slot);
+        }
+        case DBJournalRecord::COMPACT:
+            compact_rows();
+            return true;
+    }
+    return false;
+}
+
+template<typename InfoType>
+bool EmbeddingDB<InfoType>::load_mapped(const std::shared_ptr<const MappedFile>& file, bool verify_checksum) {
+    DBFileHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    // A foreign byte order, another version, a truncated file or a checksum mismatch are all rejected
+    if (header.byte_order != DB_FILE_BYTE_ORDER) return false;
+    if (header.file_size != file->size()) return false;
+    if (header.version != DB_FILE_VERSION) return false;
+    if (db_file_header_crc32(header) != header.header_checksum) return false;
+    if (verify_checksum) {
+        DBFileHeader zeroed = header;
+        zeroed.checksum = 0;
+        zeroed.header_checksum = 0;
+        uint32_t crc = db_file_crc32(&zeroed, sizeof(zeroed));
+        crc = db_file_crc32(file->data() + sizeof(header), file->size() - sizeof(header), crc);
+        if (crc != header.checksum) return false;
+    }
+
+    // Sections in file order, each within the file and large enough for what it holds.
+    // Every bound is a division so a hostile count or dim cannot overflow the check.
+    const uint64_t n = header.count;
+    const uint64_t dim = header.dim;
+    const uint64_t size = header.file_size;
+    if (dim == 0 || dim > size / sizeof(float)) return false;
+    if (header.rows_offset < sizeof(header) || header.rows_offset % DB_FILE_ALIGNMENT != 0) return false;
+    if (header.norms_offset % DB_FILE_ALIGNMENT != 0 || header.infos_offset % DB_FILE_ALIGNMENT != 0) return false;
+    if (header.rows_offset > header.norms_offset || header.norms_offset > header.infos_offset) return false;
+    if (header.infos_offset > size) return false;
+    if (n > (header.norms_offset - header.rows_offset) / sizeof(float) / dim) return false;
+    if (n > (header.infos_offset - header.norms_offset) / sizeof(float)) return false;
+    if (n >= (size - header.infos_offset) / sizeof(uint64_t)) return false;
+
+    const uint64_t* info_offsets = reinterpret_cast<const uint64_t*>(file->data() + header.infos_offset);
+    const char* info_blob = reinterpret_cast<const char*>(info_offsets + n + 1);
+    const uint64_t info_blob_size = size - (header.infos_offset + sizeof(uint64_t) * (n + 1));
+
+    auto storage = std::make_shared<Storage>();
+    storage->infos.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (info_offsets[i] > info_offsets[i + 1] || info_offsets[i + 1] > info_blob_size) return false;
+        std::istringstream iss(std::string(info_blob + info_offsets[i], info_blob + info_offsets[i + 1]));
+        iss >> storage->infos[i];
+    }
+
+    // Rows and norms are used in place, straight from the mapped pages
+    storage->mapping = file;
+    storage->rows_data = reinterpret_cast<const float*>(file->data() + header.rows_offset);
+    storage->norms_data = reinterpret_cast<const float*>(file->data() + header.norms_offset);
+    storage->capacity = n;
+    embedding_dim_ = dim;
+    snapshot_checksum_ = header.checksum;
+    storage_ = storage;
+    slots_ = n;
+    return true;
+}
+
+template<typename InfoType>
+bool EmbeddingDB<InfoType>::load_legacy(const std::string& filename) {
+    // Unversioned format: size_t dim, size_t count, column-major raw embeddings, one info per line
     std::ifstream ifs(filename, std::ios::binary);
     if (!ifs) return false;
-    clear();
     size_t n = 0;
     ifs.read(reinterpret_cast<char*>(&embedding_dim_), sizeof(embedding_dim_));
     ifs.read(reinterpret_cast<char*>(&n), sizeof(n));
-    embeddings_.resize(n, embedding_dim_);
+    if (!ifs) return false;
+    EmbeddingType raw(n, embedding_dim_);
     if (n > 0) {
-        ifs.read(reinterpret_cast<char*>(embeddings_.data()), sizeof(float) * n * embedding_dim_);
+        ifs.read(reinterpret_cast<char*>(raw.data()), sizeof(float) * n * embedding_dim_);
     }
-    infos_.resize(n);
+    Storage& storage = writable(n);
+    storage.rows.topRows(n) = raw;
+    normalize_rows(0, n);
     std::string line;
     // Read infos
     for (size_t i = 0; i < n; ++i) {
         if (!std::getline(ifs, line)) return false;
         std::istringstream iss(line);
-        iss >> infos_[i];
+        iss >> storage.infos[i];
     }
+    slots_ = n;
     return ifs.good();
 }
 
 // Explicit template instantiation for common types (optional, can be omitted if using only in headers)
-// template class EmbeddingDB<std::string>;
\ No newline at end of file
+// template class EmbeddingDB<std::string>;
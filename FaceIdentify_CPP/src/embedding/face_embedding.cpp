@@ -1,75 +1,196 @@
 #include "face_embedding.hpp"
+#include <algorithm>
+#include <cstring>
 
-FaceEmbedding::FaceEmbedding(const ModelsConfig &config) {
+FaceEmbedding::Bucket::Bucket(int batch_size)
+    : batch_size(batch_size), delegate(nullptr, TfLiteXNNPackDelegateDelete) {}
+
+
+FaceEmbedding::FaceEmbedding(const ModelsConfig &config)
+    : _weights_cache(nullptr, TfLiteXNNPackDelegateWeightsCacheDelete),
+      _preprocess(config.facenet_input_shape()) {
     this->_input_shape = config.facenet_input_shape();
     this->space_size = this->_input_shape * this->_input_shape * 3;
+    this->_threads = config.facenet_threads();
+    this->_delegate = config.facenet_delegate();
+    this->_precision = config.facenet_precision();
 
     this->_model = tflite::FlatBufferModel::BuildFromFile(config.facenet_path().c_str());
     if (!this->_model) {
         throw std::invalid_argument("Failed to load FaceEmbedding tflite model");
     }
 
-    tflite::ops::builtin::BuiltinOpResolver resolver;
+    for (int batch_size = 1; batch_size <= MAX_BATCH_SIZE; batch_size *= 2) {
+        this->_buckets.emplace_back(batch_size);
+    }
+
+    // The single face bucket is built up front to check the model and to pack the
+    // weights every later bucket shares
+    tflite::Interpreter *interpreter = this->interpreter(1);
+
+    // fp16 models keep float32 inputs and outputs, their weights are dequantized by
+    // the model itself; int8 / uint8 models need the inputs quantized
+    const TfLiteTensor *input = interpreter->tensor(interpreter->inputs()[0]);
+    this->_input_type = input->type;
+    if (this->_input_type != kTfLiteFloat32 && this->_input_type != kTfLiteInt8 &&
+        this->_input_type != kTfLiteUInt8) {
+        throw std::runtime_error("FaceEmbedding input tensor must be float32, int8 or uint8");
+    }
+    const TfLiteTensor *output = interpreter->tensor(interpreter->outputs()[0]);
+    if (output->type != kTfLiteFloat32 && output->type != kTfLiteInt8 &&
+        output->type != kTfLiteUInt8) {
+        throw std::runtime_error("FaceEmbedding output tensor must be float32, int8 or uint8");
+    }
+
+    this->_input_scale = input->params.scale;
+    this->_input_zero_point = input->params.zero_point;
+}
+
+
+tflite::Interpreter* FaceEmbedding::interpreter(int batch_size) {
+    size_t index = 0;
+    while (this->_buckets[index].batch_size < batch_size) ++index;
+    Bucket &bucket = this->_buckets[index];
+    if (bucket.interpreter) {
+        return bucket.interpreter.get();
+    }
+
+    // Delegates are applied explicitly below, not by the resolver
+    tflite::ops::builtin::BuiltinOpResolverWithoutDefaultDelegates resolver;
     tflite::InterpreterBuilder builder(*this->_model, resolver);
-    builder(&this->_interpreter);
+    builder(&bucket.interpreter);
 
-    if (!this->_interpreter) {
+    if (!bucket.interpreter) {
         throw std::runtime_error("Failed to create FaceEmbedding tflite interpreter");
     }
+    tflite::Interpreter *interpreter = bucket.interpreter.get();
+    interpreter->SetNumThreads(this->_threads);
+
+    // input shape: [batch_size, H, W, 3], fixed for the lifetime of the bucket
+    if (interpreter->ResizeInputTensorStrict(
+            interpreter->inputs()[0], {batch_size, this->_input_shape, this->_input_shape, 3}) != kTfLiteOk) {
+        throw std::runtime_error("FaceEmbedding failed to resize input tensor");
+    }
+
+    if (this->_delegate == ModelsConfig::Delegate::XNNPACK) {
+        const bool first = !this->_weights_cache;
+        if (first) {
+            this->_weights_cache.reset(TfLiteXNNPackDelegateWeightsCacheCreate());
+            if (!this->_weights_cache) {
+                throw std::runtime_error("Failed to create FaceEmbedding XNNPACK weights cache");
+            }
+        }
+
+        TfLiteXNNPackDelegateOptions options = TfLiteXNNPackDelegateOptionsDefault();
+        options.num_threads = this->_threads;
+        options.weights_cache = this->_weights_cache.get();
+        // int8 / uint8 quantized operators
+        options.flags |= TFLITE_XNNPACK_DELEGATE_FLAG_QS8 | TFLITE_XNNPACK_DELEGATE_FLAG_QU8;
+        if (this->_precision == ModelsConfig::Precision::FP16) {
+            options.flags |= TFLITE_XNNPACK_DELEGATE_FLAG_FORCE_FP16;
+        }
+        bucket.delegate.reset(TfLiteXNNPackDelegateCreate(&options));
+        if (!bucket.delegate ||
+            interpreter->ModifyGraphWithDelegate(bucket.delegate.get()) != kTfLiteOk) {
+            throw std::runtime_error("Failed to apply XNNPACK delegate to FaceEmbedding");
+        }
+
+        // Later buckets only look up the weights packed for the first one
+        if (first && !TfLiteXNNPackDelegateWeightsCacheFinalizeSoft(this->_weights_cache.get())) {
+            throw std::runtime_error("Failed to finalize FaceEmbedding XNNPACK weights cache");
+        }
+    }
+
+    if (interpreter->AllocateTensors() != kTfLiteOk) {
+        throw std::runtime_error("FaceEmbedding failed to allocate tensors");
+    }
+    return interpreter;
+}
+
+
+int FaceEmbedding::bucket_size(int n) {
+    if (n >= MAX_BATCH_SIZE) return MAX_BATCH_SIZE;
+
+    int batch_size = 1;
+    while (batch_size < n) batch_size *= 2;
+    if ((batch_size - n) * 4 > batch_size) batch_size /= 2;
+    return batch_size;
+}
+
+
+void FaceEmbedding::pad_input(tflite::Interpreter *interpreter, int slot) {
+    const TfLiteTensor *input = interpreter->tensor(interpreter->inputs()[0]);
+    if (this->_input_type != kTfLiteFloat32) {
+        std::memset(input->data.uint8 + slot * space_size, static_cast<uint8_t>(this->_input_zero_point), space_size);
+    } else {
+        std::memset(input->data.f + slot * space_size, 0, sizeof(float) * space_size);
+    }
 }
 
 
-const TfLiteTensor* FaceEmbedding::embedding(const cv::Mat &img, const cv::Rect &rect) {
-    cv::Mat face = cropImage(img, rect);
+bool FaceEmbedding::fill_input(tflite::Interpreter *interpreter, int slot, const cv::Mat &img, const cv::Rect &rect) {
+    // Crop, resize, BGR to RGB and normalization in one pass straight into the tensor
+    const TfLiteTensor *input = interpreter->tensor(interpreter->inputs()[0]);
+    bool filled;
+    if (this->_input_type != kTfLiteFloat32) {
+        filled = this->_preprocess.run(img, rect, this->_input_scale, this->_input_zero_point,
+                                       this->_input_type == kTfLiteInt8,
+                                       input->data.uint8 + slot * space_size);
+    } else {
+        filled = this->_preprocess.run(img, rect, input->data.f + slot * space_size);
+    }
 
-    if (face.empty()) return nullptr;
-    
-    if (face.rows <= 0 || face.cols <= 0) return nullptr;
-    
-    if (face.channels() == 3) {
-        cv::cvtColor(face, face, cv::COLOR_BGR2RGB);
-    } else if (face.channels() == 4) {
-        cv::cvtColor(face, face, cv::COLOR_BGRA2RGB);
+    if (!filled) {
+        this->pad_input(interpreter, slot);
     }
+    return filled;
+}
 
-    cv::resize(face, face, cv::Size(this->_input_shape, this->_input_shape), 0, 0, cv::INTER_LINEAR);
 
-    if (face.empty() || face.type() != CV_8UC3) return nullptr;
-    
-    face.convertTo(face, CV_32FC3, SCALE_FACTOR, -1.0);
-    
-    if (face.empty() || face.type() != CV_32FC3) return nullptr;
+void FaceEmbedding::read_output(const tflite::Interpreter *interpreter, int slot, float *embedding) const {
+    const TfLiteTensor *output = interpreter->tensor(interpreter->outputs()[0]);
+    const float scale = output->params.scale;
+    const int zero_point = output->params.zero_point;
 
-    // Resize input tensor if needed
-    TfLiteTensor *input = this->_interpreter->tensor(this->_interpreter->inputs()[0]);
-    if (input->dims->data[0] != 1 ||
-        input->dims->data[1] != this->_input_shape ||
-        input->dims->data[2] != this->_input_shape) {
-        if (this->_interpreter->ResizeInputTensorStrict(
-                this->_interpreter->inputs()[0], {1, this->_input_shape, this->_input_shape, 3}) != kTfLiteOk) {
-            throw std::runtime_error("FaceEmbedding failed to resize input tensor");
+    switch (output->type) {
+    case kTfLiteInt8: {
+        const int8_t *q = output->data.int8 + slot * EMBEDDING_SIZE;
+        for (int i = 0; i < EMBEDDING_SIZE; ++i) {
+            embedding[i] = (q[i] - zero_point) * scale;
         }
-        if (this->_interpreter->AllocateTensors() != kTfLiteOk) {
-            throw std::runtime_error("FaceEmbedding failed to allocate tensors after resize");
+        break;
+    }
+    case kTfLiteUInt8: {
+        const uint8_t *q = output->data.uint8 + slot * EMBEDDING_SIZE;
+        for (int i = 0; i < EMBEDDING_SIZE; ++i) {
+            embedding[i] = (q[i] - zero_point) * scale;
         }
-        input = this->_interpreter->tensor(this->_interpreter->inputs()[0]);
+        break;
     }
+    default:
+        std::memcpy(embedding, output->data.f + slot * EMBEDDING_SIZE, sizeof(float) * EMBEDDING_SIZE);
+        break;
+    }
+}
+
 
-    // input shape: [1, H, W, 3]
-    float *input_data = this->_interpreter->typed_input_tensor<float>(0);
-    //copy data to input tensor
-    std::memcpy(input_data, face.ptr<float>(), sizeof(float) * space_size);
+std::vector<float> FaceEmbedding::embedding(const cv::Mat &img, const cv::Rect &rect) {
+    tflite::Interpreter *interpreter = this->interpreter(1);
+    if (!this->fill_input(interpreter, 0, img, rect)) return {};
 
-    if (this->_interpreter->Invoke() != kTfLiteOk) {
+    if (interpreter->Invoke() != kTfLiteOk) {
         throw std::runtime_error("FaceEmbedding failed to invoke interpreter");
     }
 
     // Get output tensor
-    TfLiteTensor *output = this->_interpreter->tensor(this->_interpreter->outputs()[0]);
+    const TfLiteTensor *output = interpreter->tensor(interpreter->outputs()[0]);
     if (output->dims->data[0] != 1 || output->dims->data[1] != EMBEDDING_SIZE) {
         throw std::runtime_error("FaceEmbedding output shape mismatch");
     }
-    return output;
+
+    std::vector<float> embedding(EMBEDDING_SIZE);
+    this->read_output(interpreter, 0, embedding.data());
+    return embedding;
 }
 
 
@@ -78,63 +199,36 @@ const std::vector<std::vector<float>> FaceEmbedding::embeddings(const cv::Mat &i
 
     std::vector<std::vector<float>> empty_embeddings(faces.size(), std::vector<float>(EMBEDDING_SIZE, 0.0f));
 
-    constexpr int BATCH_SIZE = 32;
-    for (int start = 0; start < faces.size(); start += BATCH_SIZE) {
-        int end = std::min(start + BATCH_SIZE, static_cast<int>(faces.size()));
-        int batch_size = end - start;
-
-        // Resize input tensor if needed
-        TfLiteTensor *input = this->_interpreter->tensor(this->_interpreter->inputs()[0]);
-        if (input->dims->data[0] != batch_size ||
-            input->dims->data[1] != this->_input_shape ||
-            input->dims->data[2] != this->_input_shape) {
-            if (this->_interpreter->ResizeInputTensorStrict(
-                    this->_interpreter->inputs()[0], {batch_size, this->_input_shape, this->_input_shape, 3}) != kTfLiteOk) {
-                throw std::runtime_error("FaceEmbedding failed to resize input tensor");
-            }
-            if (this->_interpreter->AllocateTensors() != kTfLiteOk) {
-                throw std::runtime_error("FaceEmbedding failed to allocate tensors after resize");
-            }
-            input = this->_interpreter->tensor(this->_interpreter->inputs()[0]);
-        }
+    int start = 0;
+    while (start < static_cast<int>(faces.size())) {
+        int remaining = static_cast<int>(faces.size()) - start;
+        int batch_size = bucket_size(remaining);
+        int count = std::min(batch_size, remaining);
+        tflite::Interpreter *interpreter = this->interpreter(batch_size);
 
-        // input shape: [BATCH_SIZE, H, W, 3]
-        float *input_data = this->_interpreter->typed_input_tensor<float>(0);
-        for (int i = 0; i < batch_size; ++i) {
-            const Face &face = faces[start + i];
-            cv::Mat face_img = cropImage(img, face.bbox.getRect());
-            if (face_img.empty()) {
-                std::memset(input_data + i * space_size, 0, sizeof(float) * space_size);
-                continue;
-            }
-            if (face_img.channels() == 3) {
-                cv::cvtColor(face_img, face_img, cv::COLOR_BGR2RGB);
-            } else if (face_img.channels() == 4) {
-                cv::cvtColor(face_img, face_img, cv::COLOR_BGRA2RGB);
-            }
-            cv::resize(face_img, face_img, cv::Size(this->_input_shape, this->_input_shape), 0, 0, cv::INTER_LINEAR);
-            face_img.convertTo(face_img, CV_32FC3, SCALE_FACTOR, -1.0); // Normalize to [-1, 1]
-            std::memcpy(input_data + i * space_size, face_img.ptr<float>(), sizeof(float) * space_size);
+        for (int i = 0; i < count; ++i) {
+            this->fill_input(interpreter, i, img, faces[start + i].bbox.getRect());
+        }
+        for (int i = count; i < batch_size; ++i) {
+            this->pad_input(interpreter, i);
         }
 
-        if (this->_interpreter->Invoke() != kTfLiteOk) {
+        if (interpreter->Invoke() != kTfLiteOk) {
             throw std::runtime_error("FaceEmbedding failed to invoke interpreter");
         }
 
         // Get output tensor
-        TfLiteTensor *output = this->_interpreter->tensor(this->_interpreter->outputs()[0]);
+        const TfLiteTensor *output = interpreter->tensor(interpreter->outputs()[0]);
         if (output->dims->data[0] != batch_size || output->dims->data[1] != EMBEDDING_SIZE) {
             throw std::runtime_error("FaceEmbedding output shape mismatch");
         }
 
-        // Copy output data to embeddings
-        for (int i = 0; i < batch_size; ++i) {
-            std::vector<float> embedding(EMBEDDING_SIZE);
-            std::memcpy(embedding.data(), output->data.f + i * EMBEDDING_SIZE, sizeof(float) * EMBEDDING_SIZE);
-            empty_embeddings[start + i] = embedding;
+        // Copy output data to embeddings, padding slots are dropped
+        for (int i = 0; i < count; ++i) {
+            this->read_output(interpreter, i, empty_embeddings[start + i].data());
         }
-
+        start += count;
     }
 
     return empty_embeddings;
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #ifndef TFLITE_FACE_EMBEDDING_HPP_
 #define TFLITE_FACE_EMBEDDING_HPP_
 
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <stdexcept>
@@ -8,8 +9,10 @@
 #include <tensorflow/lite/interpreter.h>
 #include <tensorflow/lite/model.h>
 #include <tensorflow/lite/kernels/register.h>
+#include <tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h>
 
 #include "config/models_config.hpp"
+#include "embedding/face_preprocess.hpp"
 #include "mtcnn/face.h"
 #include "mtcnn/helpers.h"
 
@@ -17,11 +20,48 @@
 class FaceEmbedding {
 
     private:
+    // One interpreter per batch size, each planned once for its fixed input shape,
+    // so a changing face count never re-plans the tensor arena
+    struct Bucket {
+        int batch_size;
+        // declared before the interpreter, which must be destroyed first
+        std::unique_ptr<TfLiteDelegate, void (*)(TfLiteDelegate*)> delegate;
+        std::unique_ptr<tflite::Interpreter> interpreter;
+
+        explicit Bucket(int batch_size);
+    };
+
     std::unique_ptr<tflite::FlatBufferModel> _model;
-    std::unique_ptr<tflite::Interpreter> _interpreter;
+    // Packed XNNPACK weights, shared by the delegates of every bucket
+    std::unique_ptr<TfLiteXNNPackDelegateWeightsCache, void (*)(TfLiteXNNPackDelegateWeightsCache*)> _weights_cache;
+    std::vector<Bucket> _buckets; // batch sizes 1, 2, 4 ... MAX_BATCH_SIZE, built on first use
     int _input_shape;
     int space_size = 0;
 
+    int _threads;
+    ModelsConfig::Delegate _delegate;
+    ModelsConfig::Precision _precision;
+
+    // int8 / uint8 models take their input quantized with this scale and zero point
+    TfLiteType _input_type = kTfLiteFloat32;
+    float _input_scale = 1.0f;
+    int _input_zero_point = 0;
+    FacePreprocessor _preprocess;
+
+    // Interpreter of the bucket of batch_size, a power of two up to MAX_BATCH_SIZE
+    tflite::Interpreter* interpreter(int batch_size);
+    // Crop, resize and normalize rect of img into batch slot of the input tensor,
+    // false (and the slot padded) when rect is empty
+    bool fill_input(tflite::Interpreter* interpreter, int slot, const cv::Mat& img, const cv::Rect& rect);
+    // Fill batch slot with zeros after normalization, the zero point of a quantized input
+    void pad_input(tflite::Interpreter* interpreter, int slot);
+    // Dequantized embedding of batch slot
+    void read_output(const tflite::Interpreter* interpreter, int slot, float* embedding) const;
+
+    // Bucket to run the next n faces in: the smallest one holding them, unless more
+    // than a quarter of it would be padding, then the largest one below n
+    static int bucket_size(int n);
+
 
     FaceEmbedding(const FaceEmbedding&) = delete;
     FaceEmbedding& operator=(const FaceEmbedding&) = delete;
@@ -32,18 +72,20 @@ class FaceEmbedding {
 
     const std::vector<std::vector<float>> embeddings(const cv::Mat& img, const std::vector<Face>& faces);
 
-    inline const TfLiteTensor* embedding(const cv::Mat& img, const Face& face) {
+    // Empty when the face lies outside img
+    inline std::vector<float> embedding(const cv::Mat& img, const Face& face) {
         return this->embedding(img, face.bbox.getRect());
     }
 
-    inline const TfLiteTensor* embedding(const cv::Mat& img, const BBox& bbox) {
+    inline std::vector<float> embedding(const cv::Mat& img, const BBox& bbox) {
         return this->embedding(img, bbox.getRect());
     }
 
-    const TfLiteTensor* embedding(const cv::Mat& img, const cv::Rect& rect);
+    std::vector<float> embedding(const cv::Mat& img, const cv::Rect& rect);
 
     
     static constexpr int EMBEDDING_SIZE = 512;
+    static constexpr int MAX_BATCH_SIZE = 32;
     static constexpr float SCALE_FACTOR = 1.0 / 127.5;
 };
 
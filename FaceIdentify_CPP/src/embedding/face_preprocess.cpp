@@ -0,0 +1,207 @@
+#include "face_preprocess.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include "mtcnn/helpers.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+constexpr float SCALE = 1.0f / 127.5f;
+
+// Bilinear taps along one axis, the way cv::resize INTER_LINEAR places them, for a crop of
+// length crop_len whose part [valid_begin, valid_begin + valid_len) comes from source index
+// source_begin on and whose rest is zero padding
+void axis_taps(int crop_len, int valid_begin, int valid_len, int source_begin, int size,
+               int* index, float* weight) {
+    const double scale = static_cast<double>(crop_len) / size;
+    for (int i = 0; i < size; ++i) {
+        double f = (i + 0.5) * scale - 0.5;
+        int c0 = static_cast<int>(std::floor(f));
+        float a = static_cast<float>(f - c0);
+        if (c0 < 0) {
+            c0 = 0;
+            a = 0.0f;
+        }
+        if (c0 >= crop_len - 1) {
+            c0 = crop_len - 1;
+            a = 0.0f;
+        }
+        const int c[2] = {c0, std::min(c0 + 1, crop_len - 1)};
+        const float w[2] = {1.0f - a, a};
+        for (int k = 0; k < 2; ++k) {
+            const int v = c[k] - valid_begin;
+            const bool valid = v >= 0 && v < valid_len;
+            // a padded tap reads any pixel of the frame with weight zero
+            index[2 * i + k] = valid ? source_begin + v : 0;
+            weight[2 * i + k] = valid ? w[k] : 0.0f;
+        }
+    }
+}
+
+
+// out = (r0 * w0 + r1 * w1) / 127.5 - 1
+void blend_normalize(const float* r0, const float* r1, float w0, float w1, float* out, int n) {
+    w0 *= SCALE;
+    w1 *= SCALE;
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 vw0 = _mm256_set1_ps(w0);
+    const __m256 vw1 = _mm256_set1_ps(w1);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(r0 + i), vw0),
+                                 _mm256_mul_ps(_mm256_loadu_ps(r1 + i), vw1));
+        _mm256_storeu_ps(out + i, _mm256_sub_ps(v, one));
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t vw0 = vdupq_n_f32(w0);
+    const float32x4_t vw1 = vdupq_n_f32(w1);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t v = vmulq_f32(vld1q_f32(r0 + i), vw0);
+        v = vmlaq_f32(v, vld1q_f32(r1 + i), vw1);
+        vst1q_f32(out + i, vsubq_f32(v, one));
+    }
+#endif
+    for (; i < n; ++i) {
+        out[i] = r0[i] * w0 + r1[i] * w1 - 1.0f;
+    }
+}
+
+
+// Horizontal taps of one source row, R G B out of CN-channel BGR(A) or gray pixels
+template <int CN>
+void resample_pixels(const uint8_t* src, const int* offset, const float* weight, float* out, int size) {
+    constexpr int R = CN == 1 ? 0 : 2;
+    constexpr int B = 0;
+    constexpr int G = CN == 1 ? 0 : 1;
+    for (int x = 0; x < size; ++x, out += 3) {
+        const uint8_t* p0 = src + offset[2 * x];
+        const uint8_t* p1 = src + offset[2 * x + 1];
+        const float w0 = weight[2 * x];
+        const float w1 = weight[2 * x + 1];
+        out[0] = p0[R] * w0 + p1[R] * w1;
+        out[1] = p0[G] * w0 + p1[G] * w1;
+        out[2] = p0[B] * w0 + p1[B] * w1;
+    }
+}
+
+} // namespace
+
+
+FacePreprocessor::FacePreprocessor(int size)
+    : size_(size),
+      x_offset_(2 * size), x_weight_(2 * size),
+      y_row_(2 * size), y_weight_(2 * size),
+      quantize_row_(3 * size) {
+    if (size <= 0) {
+        throw std::invalid_argument("FacePreprocessor size must be positive");
+    }
+    this->rows_[0].resize(3 * size);
+    this->rows_[1].resize(3 * size);
+}
+
+
+bool FacePreprocessor::prepare(const cv::Mat& img, const cv::Rect& rect) {
+    if (img.empty() || rect.width <= 0 || rect.height <= 0) return false;
+    if (img.depth() != CV_8U || (img.channels() != 1 && img.channels() != 3 && img.channels() != 4)) {
+        throw std::invalid_argument("FacePreprocessor expects 8-bit gray, BGR or BGRA images");
+    }
+
+    int dx, dy;
+    cv::Rect valid = clipCropRect(img, rect, dx, dy);
+    axis_taps(rect.width, dx, std::max(0, valid.width), valid.x, this->size_,
+              this->x_offset_.data(), this->x_weight_.data());
+    axis_taps(rect.height, dy, std::max(0, valid.height), valid.y, this->size_,
+              this->y_row_.data(), this->y_weight_.data());
+
+    const int cn = img.channels();
+    for (int& offset : this->x_offset_) {
+        offset *= cn;
+    }
+    this->rows_id_[0] = this->rows_id_[1] = -1;
+    return true;
+}
+
+
+void FacePreprocessor::resample_source_row(const cv::Mat& img, int sy, int slot) {
+    const uint8_t* src = img.ptr<uint8_t>(sy);
+    float* out = this->rows_[slot].data();
+    switch (img.channels()) {
+    case 1:
+        resample_pixels<1>(src, this->x_offset_.data(), this->x_weight_.data(), out, this->size_);
+        break;
+    case 3:
+        resample_pixels<3>(src, this->x_offset_.data(), this->x_weight_.data(), out, this->size_);
+        break;
+    default:
+        resample_pixels<4>(src, this->x_offset_.data(), this->x_weight_.data(), out, this->size_);
+        break;
+    }
+    this->rows_id_[slot] = sy;
+}
+
+
+void FacePreprocessor::resample_row(const cv::Mat& img, int y, float* out) {
+    const int sy0 = this->y_row_[2 * y];
+    const int sy1 = this->y_row_[2 * y + 1];
+
+    // output rows walk down the source, so the second row of the last output row is
+    // often the first one of this output row
+    if (this->rows_id_[0] != sy0) {
+        if (this->rows_id_[1] == sy0) {
+            std::swap(this->rows_[0], this->rows_[1]);
+            std::swap(this->rows_id_[0], this->rows_id_[1]);
+        } else {
+            this->resample_source_row(img, sy0, 0);
+        }
+    }
+    if (this->rows_id_[1] != sy1) {
+        this->resample_source_row(img, sy1, 1);
+    }
+
+    blend_normalize(this->rows_[0].data(), this->rows_[1].data(),
+                    this->y_weight_[2 * y], this->y_weight_[2 * y + 1], out, 3 * this->size_);
+}
+
+
+bool FacePreprocessor::run(const cv::Mat& img, const cv::Rect& rect, float* dst) {
+    if (!this->prepare(img, rect)) return false;
+
+    const int row = 3 * this->size_;
+    for (int y = 0; y < this->size_; ++y) {
+        this->resample_row(img, y, dst + static_cast<size_t>(y) * row);
+    }
+    return true;
+}
+
+
+bool FacePreprocessor::run(const cv::Mat& img, const cv::Rect& rect, float scale, int zero_point,
+                           bool is_signed, uint8_t* dst) {
+    if (!this->prepare(img, rect)) return false;
+
+    const int row = 3 * this->size_;
+    const float inv_scale = 1.0f / scale;
+    const int qmin = is_signed ? -128 : 0;
+    const int qmax = is_signed ? 127 : 255;
+    float* values = this->quantize_row_.data();
+    for (int y = 0; y < this->size_; ++y) {
+        this->resample_row(img, y, values);
+        uint8_t* out = dst + static_cast<size_t>(y) * row;
+        for (int i = 0; i < row; ++i) {
+            int q = static_cast<int>(std::lrint(values[i] * inv_scale)) + zero_point;
+            // int8 values are stored through their two's complement byte
+            out[i] = static_cast<uint8_t>(std::min(std::max(q, qmin), qmax));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef __face_preprocess_hpp__
+#define __face_preprocess_hpp__
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+
+// Single-pass FaceNet input preparation: crops a face out of the frame, resizes it bilinearly,
+// swaps BGR to RGB and normalizes it to [-1, 1], sampling straight from the frame into the
+// input tensor. The crop is zero padded where it leaves the frame, as cropImage() does, which
+// costs nothing extra: padded taps just get a zero weight.
+//
+// Each output row is blended from two horizontally resampled source rows, which are cached
+// while consecutive output rows share them; the blend and normalization run on AVX2 or NEON
+// when the build enables them.
+class FacePreprocessor {
+public:
+    // size x size x 3 output
+    explicit FacePreprocessor(int size);
+
+    // Write the face at rect of the 8-bit gray, BGR or BGRA img to dst as size x size RGB in
+    // [-1, 1]. False, and dst untouched, when rect or img is empty.
+    bool run(const cv::Mat& img, const cv::Rect& rect, float* dst);
+
+    // As above, quantized as round(v / scale) + zero_point to int8 (is_signed) or uint8
+    bool run(const cv::Mat& img, const cv::Rect& rect, float scale, int zero_point, bool is_signed,
+             uint8_t* dst);
+
+    int size() const { return size_; }
+
+private:
+    int size_;
+
+    // Two taps per output column / row: source byte offset (columns) or source row (rows)
+    // and weight, zero for taps in the padding
+    std::vector<int> x_offset_;
+    std::vector<float> x_weight_;
+    std::vector<int> y_row_;
+    std::vector<float> y_weight_;
+
+    // Horizontally resampled source rows, RGB, and the source row each holds
+    std::vector<float> rows_[2];
+    int rows_id_[2];
+
+    std::vector<float> quantize_row_;
+
+    // Taps of rect in img, false when there is nothing to sample
+    bool prepare(const cv::Mat& img, const cv::Rect& rect);
+
+    // Normalized output row y
+    void resample_row(const cv::Mat& img, int y, float* out);
+
+    // Horizontally resampled source row sy into rows_[slot]
+    void resample_source_row(const cv::Mat& img, int sy, int slot);
+};
+
+#endif // __face_preprocess_hpp__
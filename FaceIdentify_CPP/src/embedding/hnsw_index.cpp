@@ -0,0 +1,353 @@
+#include "hnsw_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+#include <Eigen/Dense>
+
+#include "db_file.hpp"
+
+namespace {
+
+constexpr uint32_t HNSW_MAGIC = 0x57534E48; // "HNSW"
+constexpr uint32_t HNSW_VERSION = 2;
+
+// Bounds on what a file may claim before anything is allocated for it
+constexpr uint64_t HNSW_MAX_M = 1 << 12;
+constexpr int32_t HNSW_MAX_LEVEL = 64;
+
+template<typename T>
+void write_pod(std::ofstream& ofs, const T& value) {
+    ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool read_pod(std::ifstream& ifs, T& value) {
+    return static_cast<bool>(ifs.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+} // namespace
+
+
+HNSWIndex::HNSWIndex(size_t dim, const Params& params)
+    : dim_(dim), params_(params), rng_(params.seed) {
+    if (this->dim_ == 0) throw std::invalid_argument("HNSWIndex dimension must be non-zero");
+    if (this->params_.M < 2) this->params_.M = 2;
+    this->level_mult_ = 1.0 / std::log(static_cast<double>(this->params_.M));
+}
+
+
+float HNSWIndex::distance(const float* query, uint32_t node) const {
+    Eigen::Map<const Eigen::VectorXf> a(query, this->dim_);
+    Eigen::Map<const Eigen::VectorXf> b(this->vector(node), this->dim_);
+    return 1.0f - a.dot(b);
+}
+
+
+int HNSWIndex::random_level() {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double u = std::max(uniform(this->rng_), 1e-12);
+    return static_cast<int>(-std::log(u) * this->level_mult_);
+}
+
+
+uint32_t HNSWIndex::descend(const float* query, uint32_t entry, int level) const {
+    float best = this->distance(query, entry);
+    for (int l = this->max_level_; l > level; --l) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (uint32_t nb : this->links_[entry][l]) {
+                float d = this->distance(query, nb);
+                if (d < best) {
+                    best = d;
+                    entry = nb;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return entry;
+}
+
+
+std::vector<HNSWIndex::Candidate> HNSWIndex::search_layer(const float* query, uint32_t entry,
+                                                          size_t ef, int level) const {
+    // Visited marks are epoch tagged and reused per thread, so a search does not clear or allocate them
+    thread_local std::vector<uint32_t> visited;
+    thread_local uint32_t epoch = 0;
+    if (visited.size() < this->labels_.size()) visited.resize(this->labels_.size(), 0);
+    if (++epoch == 0) {
+        std::fill(visited.begin(), visited.end(), 0);
+        epoch = 1;
+    }
+
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+    std::priority_queue<Candidate> results;
+
+    float d = this->distance(query, entry);
+    candidates.emplace(d, entry);
+    results.emplace(d, entry);
+    visited[entry] = epoch;
+
+    while (!candidates.empty()) {
+        Candidate current = candidates.top();
+        if (current.first > results.top().first && results.size() >= ef) break;
+        candidates.pop();
+
+        for (uint32_t nb : this->links_[current.second][level]) {
+            if (visited[nb] == epoch) continue;
+            visited[nb] = epoch;
+            float dn = this->distance(query, nb);
+            if (results.size() < ef || dn < results.top().first) {
+                candidates.emplace(dn, nb);
+                results.emplace(dn, nb);
+                if (results.size() > ef) results.pop();
+            }
+        }
+    }
+
+    std::vector<Candidate> ordered(results.size());
+    for (size_t i = ordered.size(); i-- > 0;) {
+        ordered[i] = results.top();
+        results.pop();
+    }
+    return ordered;
+}
+
+
+std::vector<uint32_t> HNSWIndex::select_neighbors(const std::vector<Candidate>& candidates, size_t m) const {
+    std::vector<uint32_t> selected;
+    selected.reserve(m);
+    for (const auto& [d, node] : candidates) {
+        if (selected.size() >= m) break;
+        // Keep a candidate only if it is closer to the base than to any neighbour already kept
+        bool keep = true;
+        for (uint32_t s : selected) {
+            if (this->distance(this->vector(node), s) < d) {
+                keep = false;
+                break;
+            }
+        }
+        if (keep) selected.push_back(node);
+    }
+    return selected;
+}
+
+
+void HNSWIndex::insert(size_t label, const float* vec) {
+    if (this->label_to_node_.count(label)) {
+        throw std::invalid_argument("HNSWIndex label already exists");
+    }
+
+    uint32_t node = static_cast<uint32_t>(this->labels_.size());
+    int level = this->random_level();
+    this->data_.insert(this->data_.end(), vec, vec + this->dim_);
+    this->labels_.push_back(label);
+    this->levels_.push_back(level);
+    this->links_.emplace_back(level + 1);
+    this->deleted_.push_back(0);
+    this->label_to_node_[label] = node;
+
+    if (this->entry_point_ < 0) {
+        this->entry_point_ = node;
+        this->max_level_ = level;
+        return;
+    }
+
+    const float* query = this->vector(node);
+    uint32_t entry = this->descend(query, static_cast<uint32_t>(this->entry_point_), level);
+
+    for (int l = std::min(level, this->max_level_); l >= 0; --l) {
+        std::vector<Candidate> candidates = this->search_layer(query, entry, this->params_.ef_construction, l);
+        this->links_[node][l] = this->select_neighbors(candidates, this->params_.M);
+
+        for (uint32_t nb : this->links_[node][l]) {
+            std::vector<uint32_t>& nb_links = this->links_[nb][l];
+            nb_links.push_back(node);
+            if (nb_links.size() > this->max_links(l)) {
+                std::vector<Candidate> pruned;
+                pruned.reserve(nb_links.size());
+                for (uint32_t x : nb_links) {
+                    pruned.emplace_back(this->distance(this->vector(nb), x), x);
+                }
+                std::sort(pruned.begin(), pruned.end());
+                nb_links = this->select_neighbors(pruned, this->max_links(l));
+            }
+        }
+        entry = candidates.front().second;
+    }
+
+    if (level > this->max_level_) {
+        this->max_level_ = level;
+        this->entry_point_ = node;
+    }
+}
+
+
+bool HNSWIndex::erase(size_t label) {
+    auto it = this->label_to_node_.find(label);
+    if (it == this->label_to_node_.end()) return false;
+    this->deleted_[it->second] = 1;
+    this->label_to_node_.erase(it);
+    return true;
+}
+
+
+std::vector<std::pair<size_t, float>> HNSWIndex::search(const float* query, size_t k) const {
+    std::vector<std::pair<size_t, float>> results;
+    if (this->entry_point_ < 0 || this->label_to_node_.empty() || k == 0) return results;
+
+    uint32_t entry = this->descend(query, static_cast<uint32_t>(this->entry_point_), 0);
+    std::vector<Candidate> candidates =
+        this->search_layer(query, entry, std::max(this->params_.ef_search, k), 0);
+
+    results.reserve(k);
+    for (const auto& [d, node] : candidates) {
+        if (this->deleted_[node]) continue;
+        results.emplace_back(this->labels_[node], 1.0f - d);
+        if (results.size() == k) break;
+    }
+    return results;
+}
+
+
+bool HNSWIndex::store(const std::string& filename, uint32_t source_checksum) const {
+    // Written aside and renamed, a crash never leaves a half-written graph under filename
+    const std::string tmp_filename = filename + ".tmp";
+    {
+        std::ofstream ofs(tmp_filename, std::ios::binary | std::ios::trunc);
+        if (!ofs) return false;
+
+        write_pod(ofs, HNSW_MAGIC);
+        write_pod(ofs, HNSW_VERSION);
+        write_pod(ofs, source_checksum);
+        write_pod(ofs, static_cast<uint64_t>(this->dim_));
+        write_pod(ofs, static_cast<uint64_t>(this->params_.M));
+        write_pod(ofs, static_cast<uint64_t>(this->params_.ef_construction));
+        write_pod(ofs, static_cast<uint64_t>(this->labels_.size()));
+        write_pod(ofs, this->entry_point_);
+        write_pod(ofs, static_cast<int32_t>(this->max_level_));
+
+        for (uint32_t node = 0; node < this->labels_.size(); ++node) {
+            write_pod(ofs, static_cast<uint64_t>(this->labels_[node]));
+            write_pod(ofs, static_cast<int32_t>(this->levels_[node]));
+            write_pod(ofs, this->deleted_[node]);
+            ofs.write(reinterpret_cast<const char*>(this->vector(node)), sizeof(float) * this->dim_);
+            for (const auto& layer : this->links_[node]) {
+                write_pod(ofs, static_cast<uint32_t>(layer.size()));
+                ofs.write(reinterpret_cast<const char*>(layer.data()), sizeof(uint32_t) * layer.size());
+            }
+        }
+        ofs.flush();
+        if (!ofs.good()) {
+            std::remove(tmp_filename.c_str());
+            return false;
+        }
+    }
+    if (!db_file_sync(tmp_filename) || std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp_filename.c_str());
+        return false;
+    }
+    return db_file_sync_dir(filename);
+}
+
+
+bool HNSWIndex::load(const std::string& filename, uint32_t source_checksum) {
+    std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+    if (!ifs) return false;
+    const uint64_t file_size = static_cast<uint64_t>(ifs.tellg());
+    ifs.seekg(0);
+
+    uint32_t magic = 0, version = 0, checksum = 0;
+    uint64_t dim = 0, m = 0, ef_construction = 0, count = 0;
+    int64_t entry_point = -1;
+    int32_t max_level = -1;
+    if (!read_pod(ifs, magic) || magic != HNSW_MAGIC) return false;
+    if (!read_pod(ifs, version) || version != HNSW_VERSION) return false;
+    if (!read_pod(ifs, checksum) || checksum != source_checksum) return false;
+    if (!read_pod(ifs, dim) || dim != this->dim_) return false;
+    if (!read_pod(ifs, m) || !read_pod(ifs, ef_construction) || !read_pod(ifs, count)) return false;
+    if (!read_pod(ifs, entry_point) || !read_pod(ifs, max_level)) return false;
+    if (m < 2 || m > HNSW_MAX_M) return false;
+
+    // Every node takes at least its label, level, tombstone, vector and one link count
+    const uint64_t min_node_bytes = sizeof(uint64_t) + sizeof(int32_t) + sizeof(uint8_t) +
+                                    sizeof(float) * dim + sizeof(uint32_t);
+    const uint64_t header_bytes = static_cast<uint64_t>(ifs.tellg());
+    if (count > (file_size - header_bytes) / min_node_bytes) return false;
+
+    this->clear();
+    this->params_.M = m;
+    this->params_.ef_construction = ef_construction;
+    this->level_mult_ = 1.0 / std::log(static_cast<double>(this->params_.M));
+    auto fail = [this] {
+        this->clear();
+        return false;
+    };
+
+    this->data_.resize(count * this->dim_);
+    this->labels_.resize(count);
+    this->levels_.resize(count);
+    this->links_.resize(count);
+    this->deleted_.resize(count);
+
+    for (uint32_t node = 0; node < count; ++node) {
+        uint64_t label = 0;
+        int32_t level = 0;
+        if (!read_pod(ifs, label) || !read_pod(ifs, level) || !read_pod(ifs, this->deleted_[node])) return fail();
+        if (level < 0 || level > HNSW_MAX_LEVEL) return fail();
+        this->labels_[node] = label;
+        this->levels_[node] = level;
+        ifs.read(reinterpret_cast<char*>(this->data_.data() + node * this->dim_), sizeof(float) * this->dim_);
+        this->links_[node].resize(level + 1);
+        for (int l = 0; l <= level; ++l) {
+            uint32_t size = 0;
+            if (!read_pod(ifs, size) || size > this->max_links(l)) return fail();
+            std::vector<uint32_t>& layer = this->links_[node][l];
+            layer.resize(size);
+            ifs.read(reinterpret_cast<char*>(layer.data()), sizeof(uint32_t) * size);
+            for (uint32_t nb : layer) {
+                if (nb >= count) return fail();
+            }
+        }
+        if (!this->deleted_[node] && !this->label_to_node_.emplace(label, node).second) return fail();
+    }
+    if (!ifs) return fail();
+
+    // A link on layer l must lead to a node that has layer l, searches index links_[nb][l]
+    for (uint32_t node = 0; node < count; ++node) {
+        for (int l = 0; l <= this->levels_[node]; ++l) {
+            for (uint32_t nb : this->links_[node][l]) {
+                if (this->levels_[nb] < l) return fail();
+            }
+        }
+    }
+
+    // The entry point starts every descent, from its own top layer
+    if (count == 0) {
+        if (entry_point != -1 || max_level != -1) return fail();
+    } else if (entry_point < 0 || static_cast<uint64_t>(entry_point) >= count ||
+               this->levels_[entry_point] != max_level) {
+        return fail();
+    }
+
+    this->entry_point_ = entry_point;
+    this->max_level_ = max_level;
+    return true;
+}
+
+
+void HNSWIndex::clear() {
+    this->data_.clear();
+    this->labels_.clear();
+    this->levels_.clear();
+    this->links_.clear();
+    this->deleted_.clear();
+    this->label_to_node_.clear();
+    this->entry_point_ = -1;
+    this->max_level_ = -1;
+}
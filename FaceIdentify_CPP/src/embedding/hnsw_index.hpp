@@ -0,0 +1,94 @@
+#ifndef __hnsw_index_hpp__
+#define __hnsw_index_hpp__
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+struct HNSWParams {
+    size_t M = 16;                // links per node on upper layers (2 * M on layer 0)
+    size_t ef_construction = 200; // candidate list size while inserting
+    size_t ef_search = 64;        // candidate list size while searching (recall / latency knob)
+    unsigned int seed = 100;
+};
+
+
+// Hierarchical Navigable Small World graph over unit-normalized embeddings.
+// Similarity is the inner product. Erased nodes are tombstoned: they keep routing
+// searches through the graph but are never returned, and take memory until the graph
+// is rebuilt (EmbeddingDB rebuilds it when it compacts its rows).
+class HNSWIndex {
+public:
+    using Params = HNSWParams;
+
+    static constexpr size_t NPOS = static_cast<size_t>(-1);
+
+    explicit HNSWIndex(size_t dim, const Params& params = Params());
+    HNSWIndex(const HNSWIndex&) = delete;
+    HNSWIndex& operator=(const HNSWIndex&) = delete;
+
+    // Insert a unit-normalized vector under a unique label
+    void insert(size_t label, const float* vec);
+
+    // Tombstone the node holding label
+    bool erase(size_t label);
+
+    // Up to k (label, inner product) pairs, ordered by decreasing similarity
+    std::vector<std::pair<size_t, float>> search(const float* query, size_t k) const;
+
+    // store to / load from file, load keeps the current ef_search. source_checksum names the
+    // rows the graph was built from, load fails on a graph of other rows or a damaged file.
+    bool store(const std::string& filename, uint32_t source_checksum) const;
+    bool load(const std::string& filename, uint32_t source_checksum);
+
+    void clear();
+
+    // Number of live (not erased) nodes
+    size_t size() const { return label_to_node_.size(); }
+
+    // Number of nodes, erased ones included
+    size_t nodes() const { return labels_.size(); }
+
+    size_t dim() const { return dim_; }
+
+    const Params& params() const { return params_; }
+
+    void set_ef_search(size_t ef) { params_.ef_search = ef; }
+
+private:
+    using Candidate = std::pair<float, uint32_t>; // (distance, node)
+
+    const float* vector(uint32_t node) const { return data_.data() + static_cast<size_t>(node) * dim_; }
+    float distance(const float* query, uint32_t node) const;
+    size_t max_links(int level) const { return level == 0 ? 2 * params_.M : params_.M; }
+    int random_level();
+
+    // Greedy descent with a single candidate from max_level_ down to level + 1
+    uint32_t descend(const float* query, uint32_t entry, int level) const;
+
+    // Beam search on one layer, returns candidates ordered by increasing distance
+    std::vector<Candidate> search_layer(const float* query, uint32_t entry, size_t ef, int level) const;
+
+    // Neighbour selection heuristic from the HNSW paper (candidates ordered by distance)
+    std::vector<uint32_t> select_neighbors(const std::vector<Candidate>& candidates, size_t m) const;
+
+    size_t dim_;
+    Params params_;
+    double level_mult_;
+    std::mt19937 rng_;
+
+    std::vector<float> data_;      // node vectors, dim_ floats each
+    std::vector<size_t> labels_;   // label of each node
+    std::vector<int> levels_;      // top layer of each node
+    std::vector<uint8_t> deleted_; // tombstones
+    std::vector<std::vector<std::vector<uint32_t>>> links_; // links_[node][layer]
+    std::unordered_map<size_t, uint32_t> label_to_node_;
+    int64_t entry_point_ = -1;
+    int max_level_ = -1;
+};
+
+#endif // __hnsw_index_hpp__
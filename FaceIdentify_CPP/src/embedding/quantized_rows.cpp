@@ -0,0 +1,236 @@
+#include "quantized_rows.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Inner product of two int8 vectors with int32 accumulation
+int32_t dot_i8(const int8_t* a, const int8_t* b, size_t n) {
+    size_t i = 0;
+    int32_t sum = 0;
+#if defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 16 <= n; i += 16) {
+        __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_hadd_epi32(s, s);
+    s = _mm_hadd_epi32(s, s);
+    sum = _mm_cvtsi128_si32(s);
+#elif defined(__ARM_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 16 <= n; i += 16) {
+        int8x16_t va = vld1q_s8(a + i);
+        int8x16_t vb = vld1q_s8(b + i);
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        acc = vpadalq_s16(acc, vmull_s8(vget_high_s8(va), vget_high_s8(vb)));
+    }
+#if defined(__aarch64__)
+    sum = vaddvq_s32(acc);
+#else
+    sum = vgetq_lane_s32(acc, 0) + vgetq_lane_s32(acc, 1) + vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3);
+#endif
+#endif
+    for (; i < n; ++i) {
+        sum += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]);
+    }
+    return sum;
+}
+
+
+// Inner product of an fp32 query with an fp16 row
+float dot_f16(const float* query, const uint16_t* row, size_t n) {
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(__AVX2__) && defined(__F16C__) && defined(__FMA__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m256 r = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i)));
+        acc = _mm256_fmadd_ps(r, _mm256_loadu_ps(query + i), acc);
+    }
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+    sum = _mm_cvtss_f32(s);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t r = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(row + i)));
+        acc = vfmaq_f32(acc, r, vld1q_f32(query + i));
+    }
+    sum = vaddvq_f32(acc);
+#endif
+    for (; i < n; ++i) {
+        sum += query[i] * QuantizedRows::half_to_float(row[i]);
+    }
+    return sum;
+}
+
+
+// Symmetric int8 quantization, returns the scale that maps codes back to floats
+float quantize_i8(const float* src, int8_t* dst, size_t n) {
+    float max_abs = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        max_abs = std::max(max_abs, std::abs(src[i]));
+    }
+    if (max_abs == 0.0f) {
+        std::memset(dst, 0, n);
+        return 0.0f;
+    }
+    float inv_scale = 127.0f / max_abs;
+    for (size_t i = 0; i < n; ++i) {
+        float q = std::nearbyint(src[i] * inv_scale);
+        dst[i] = static_cast<int8_t>(std::clamp(q, -127.0f, 127.0f));
+    }
+    return max_abs / 127.0f;
+}
+
+} // namespace
+
+
+QuantizedRows::QuantizedRows(size_t dim, Mode mode, size_t capacity)
+    : dim_(dim), mode_(mode) {
+    if (this->dim_ == 0) throw std::invalid_argument("QuantizedRows dimension must be non-zero");
+    if (this->mode_ == Mode::NONE) throw std::invalid_argument("QuantizedRows requires FP16 or INT8 mode");
+    this->allocate(capacity);
+}
+
+
+QuantizedRows::QuantizedRows(const QuantizedRows& other, size_t capacity)
+    : dim_(other.dim_), mode_(other.mode_) {
+    size_t size = other.size();
+    this->allocate(std::max(capacity, size));
+    if (this->mode_ == Mode::INT8) {
+        std::copy_n(other.int8_rows_.begin(), size * this->dim_, this->int8_rows_.begin());
+        std::copy_n(other.int8_scales_.begin(), size, this->int8_scales_.begin());
+    } else {
+        std::copy_n(other.half_rows_.begin(), size * this->dim_, this->half_rows_.begin());
+    }
+    this->size_.store(size, std::memory_order_release);
+}
+
+
+void QuantizedRows::allocate(size_t capacity) {
+    if (this->mode_ == Mode::INT8) {
+        this->int8_rows_.resize(capacity * this->dim_);
+        this->int8_scales_.resize(capacity);
+    } else {
+        this->half_rows_.resize(capacity * this->dim_);
+    }
+    this->capacity_ = capacity;
+}
+
+
+void QuantizedRows::append(const float* row) {
+    size_t size = this->size_.load(std::memory_order_relaxed);
+    if (size == this->capacity_) this->allocate(std::max<size_t>(2 * this->capacity_, 16));
+
+    if (this->mode_ == Mode::INT8) {
+        this->int8_scales_[size] = quantize_i8(row, this->int8_rows_.data() + size * this->dim_, this->dim_);
+    } else {
+        uint16_t* dst = this->half_rows_.data() + size * this->dim_;
+        for (size_t i = 0; i < this->dim_; ++i) {
+            dst[i] = float_to_half(row[i]);
+        }
+    }
+    // Publish the row only after its codes are written
+    this->size_.store(size + 1, std::memory_order_release);
+}
+
+
+void QuantizedRows::scores(const float* query, float* out, size_t first, size_t count) const {
+    if (first + count > this->size()) throw std::out_of_range("QuantizedRows score range out of bounds");
+
+    if (this->mode_ == Mode::INT8) {
+        // Quantize the query once, then every row costs one int8 dot product
+        thread_local std::vector<int8_t> query_codes;
+        query_codes.resize(this->dim_);
+        float query_scale = quantize_i8(query, query_codes.data(), this->dim_);
+        for (size_t i = first; i < first + count; ++i) {
+            int32_t dot = dot_i8(query_codes.data(), this->int8_rows_.data() + i * this->dim_, this->dim_);
+            *out++ = static_cast<float>(dot) * query_scale * this->int8_scales_[i];
+        }
+    } else {
+        for (size_t i = first; i < first + count; ++i) {
+            *out++ = dot_f16(query, this->half_rows_.data() + i * this->dim_, this->dim_);
+        }
+    }
+}
+
+
+size_t QuantizedRows::bytes() const {
+    return this->int8_rows_.capacity() * sizeof(int8_t) + this->int8_scales_.capacity() * sizeof(float) +
+           this->half_rows_.capacity() * sizeof(uint16_t);
+}
+
+
+uint16_t QuantizedRows::float_to_half(float value) {
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    uint32_t sign = (f >> 16) & 0x8000;
+    uint32_t raw_exp = (f >> 23) & 0xff;
+    uint32_t mant = f & 0x7fffff;
+
+    if (raw_exp == 0xff) return static_cast<uint16_t>(sign | 0x7c00 | (mant ? 0x200 : 0)); // inf / nan
+    int32_t exp = static_cast<int32_t>(raw_exp) - 127 + 15;
+    if (exp >= 31) return static_cast<uint16_t>(sign | 0x7c00); // overflow to inf
+
+    if (exp <= 0) {
+        // Subnormal half, round to nearest even
+        if (exp < -10) return static_cast<uint16_t>(sign);
+        mant |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exp);
+        uint32_t half_mant = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (half_mant & 1))) ++half_mant;
+        return static_cast<uint16_t>(sign | half_mant);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(exp) << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) ++half; // a carry rolls into the exponent
+    return static_cast<uint16_t>(half);
+}
+
+
+float QuantizedRows::half_to_float(uint16_t value) {
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exp = (value >> 10) & 0x1f;
+    uint32_t mant = value & 0x3ff;
+    uint32_t f;
+
+    if (exp == 0) {
+        if (mant == 0) {
+            f = sign;
+        } else {
+            // Normalize the subnormal
+            int32_t e = 1;
+            while (!(mant & 0x400)) {
+                mant <<= 1;
+                --e;
+            }
+            mant &= 0x3ff;
+            f = sign | (static_cast<uint32_t>(e + 112) << 23) | (mant << 13);
+        }
+    } else if (exp == 31) {
+        f = sign | 0x7f800000 | (mant << 13);
+    } else {
+        f = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &f, sizeof(result));
+    return result;
+}
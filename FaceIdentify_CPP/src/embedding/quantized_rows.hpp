@@ -0,0 +1,65 @@
+#ifndef __quantized_rows_hpp__
+#define __quantized_rows_hpp__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Compact copy of unit-normalized embedding rows used for bandwidth-bound scans.
+// INT8 stores each row with its own scale (max |x| / 127), FP16 stores IEEE half floats.
+// Dot products run on AVX2 (+F16C/FMA) or NEON when the build enables them.
+//
+// Rows below size() are never written again, so scans of them may run on other threads while
+// one writer appends, as long as the append stays within capacity().
+class QuantizedRows {
+public:
+    enum class Mode { NONE, FP16, INT8 };
+
+    QuantizedRows(size_t dim, Mode mode, size_t capacity = 0);
+
+    // Copy of the rows of other with room for capacity rows
+    QuantizedRows(const QuantizedRows& other, size_t capacity);
+
+    QuantizedRows& operator=(const QuantizedRows&) = delete;
+
+    // Append a row, quantized according to mode(). A full buffer is reallocated.
+    void append(const float* row);
+
+    // Approximate inner products of query against rows [first, first + count)
+    void scores(const float* query, float* out, size_t first, size_t count) const;
+
+    // Approximate inner products of query against every row
+    void scores(const float* query, float* out) const {
+        this->scores(query, out, 0, this->size());
+    }
+
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+
+    size_t capacity() const { return capacity_; }
+
+    size_t dim() const { return dim_; }
+
+    Mode mode() const { return mode_; }
+
+    // Bytes allocated for the quantized rows
+    size_t bytes() const;
+
+    static uint16_t float_to_half(float value);
+    static float half_to_float(uint16_t value);
+
+private:
+    size_t dim_;
+    Mode mode_;
+    std::atomic<size_t> size_ = 0;
+    size_t capacity_ = 0;
+    std::vector<int8_t> int8_rows_;   // INT8: capacity_ x dim_
+    std::vector<float> int8_scales_;  // INT8: one scale per row
+    std::vector<uint16_t> half_rows_; // FP16: capacity_ x dim_
+
+    // Resize the buffers to capacity rows
+    void allocate(size_t capacity);
+};
+
+#endif // __quantized_rows_hpp__
@@ -0,0 +1,72 @@
+#include "scan_pool.hpp"
+
+
+ScanPool::ScanPool(size_t threads) {
+    for (size_t i = 1; i < threads; ++i) {
+        this->workers_.emplace_back(&ScanPool::worker, this);
+    }
+}
+
+
+ScanPool::~ScanPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->stop_ = true;
+    }
+    this->start_cv_.notify_all();
+    for (auto& worker : this->workers_) {
+        worker.join();
+    }
+}
+
+
+void ScanPool::run(size_t tasks, const std::function<void(size_t)>& fn) {
+    std::unique_lock<std::mutex> run_lock(this->run_mutex_, std::try_to_lock);
+    if (!run_lock || this->workers_.empty() || tasks < 2) {
+        for (size_t task = 0; task < tasks; ++task) fn(task);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->job_ = &fn;
+        this->tasks_ = tasks;
+        this->next_.store(0, std::memory_order_relaxed);
+        this->finished_ = 0;
+        ++this->generation_;
+    }
+    this->start_cv_.notify_all();
+    this->drain(fn, tasks);
+
+    // Every worker checks in once per generation, so none can still hold fn once this returns
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->done_cv_.wait(lock, [this] { return this->finished_ == this->workers_.size(); });
+    this->job_ = nullptr;
+}
+
+
+void ScanPool::drain(const std::function<void(size_t)>& fn, size_t tasks) {
+    for (size_t task = this->next_.fetch_add(1, std::memory_order_relaxed); task < tasks;
+         task = this->next_.fetch_add(1, std::memory_order_relaxed)) {
+        fn(task);
+    }
+}
+
+
+void ScanPool::worker() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    while (true) {
+        this->start_cv_.wait(lock, [&] { return this->stop_ || this->generation_ != seen; });
+        if (this->stop_) return;
+        seen = this->generation_;
+        const std::function<void(size_t)>* job = this->job_;
+        size_t tasks = this->tasks_;
+
+        lock.unlock();
+        this->drain(*job, tasks);
+        lock.lock();
+
+        if (++this->finished_ == this->workers_.size()) this->done_cv_.notify_one();
+    }
+}
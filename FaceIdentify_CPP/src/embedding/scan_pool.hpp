@@ -0,0 +1,52 @@
+#ifndef __scan_pool_hpp__
+#define __scan_pool_hpp__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Persistent fork-join pool for sharded EmbeddingDB scans. run() hands out task indices from
+// an atomic counter to the workers and the calling thread, and returns once every task ran.
+//
+// One job runs at a time. A caller that finds the pool busy with another query runs its own
+// tasks inline, so concurrent readers never queue behind each other.
+class ScanPool {
+public:
+    // threads counts the calling thread, threads - 1 workers are started
+    explicit ScanPool(size_t threads);
+    ~ScanPool();
+
+    ScanPool(const ScanPool&) = delete;
+    ScanPool& operator=(const ScanPool&) = delete;
+
+    // Call fn(task) for every task in [0, tasks)
+    void run(size_t tasks, const std::function<void(size_t)>& fn);
+
+    size_t threads() const { return workers_.size() + 1; }
+
+private:
+    void worker();
+
+    // Claim tasks of the current job until none are left
+    void drain(const std::function<void(size_t)>& fn, size_t tasks);
+
+    std::vector<std::thread> workers_;
+    std::mutex run_mutex_; // Held by the caller whose job the workers are running
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(size_t)>* job_ = nullptr;
+    size_t tasks_ = 0;
+    std::atomic<size_t> next_ = 0;
+    size_t finished_ = 0;    // Workers done with the current generation
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+};
+
+#endif // __scan_pool_hpp__
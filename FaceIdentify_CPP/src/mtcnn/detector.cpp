@@ -1,21 +1,37 @@
 #include "detector.hpp"
 
 
+// path is the model file name without extension, det1 selects det1.prototxt
+// and det1.caffemodel or det1.tflite depending on the backend
+static StageNet::Model stageModel(const ModelsConfig &modelsConfig,
+                                  const std::string &path) {
+    StageNet::Model model;
+    model.backend = modelsConfig.mtcnn_backend() == ModelsConfig::MtcnnBackend::TFLITE
+                        ? StageNet::Backend::TFLITE : StageNet::Backend::CAFFE;
+    model.caffeModel = path + ".caffemodel";
+    model.protoText = path + ".prototxt";
+    model.tfliteModel = path + ".tflite";
+    model.threads = modelsConfig.mtcnn_threads();
+    model.xnnpack = modelsConfig.mtcnn_delegate() == ModelsConfig::Delegate::XNNPACK;
+    return model;
+}
+
+
 MTCNNDetector::MTCNNDetector(const ModelsConfig &modelsConfig) {
     ProposalNetwork::Config pConfig;
-    pConfig.caffeModel = modelsConfig.pnet_path() + ".caffemodel";
-    pConfig.protoText = modelsConfig.pnet_path() + ".prototxt";
+    pConfig.model = stageModel(modelsConfig, modelsConfig.pnet_path());
     pConfig.threshold = modelsConfig.pnet_threshold();
+    pConfig.threads = modelsConfig.pnet_threads();
 
     RefineNetwork::Config rConfig;
-    rConfig.caffeModel = modelsConfig.rnet_path() + ".caffemodel";
-    rConfig.protoText = modelsConfig.rnet_path() + ".prototxt";
+    rConfig.model = stageModel(modelsConfig, modelsConfig.rnet_path());
     rConfig.threshold = modelsConfig.rnet_threshold();
+    rConfig.maxBatch = modelsConfig.mtcnn_max_batch();
     
     OutputNetwork::Config oConfig;
-    oConfig.caffeModel = modelsConfig.onet_path() + ".caffemodel";
-    oConfig.protoText = modelsConfig.onet_path() + ".prototxt";
+    oConfig.model = stageModel(modelsConfig, modelsConfig.onet_path());
     oConfig.threshold = modelsConfig.onet_threshold();
+    oConfig.maxBatch = modelsConfig.mtcnn_max_batch();
 
 
     _pnet = std::make_unique<ProposalNetwork>(pConfig);
@@ -29,20 +45,16 @@ std::vector<Face> MTCNNDetector::detect(const cv::Mat &img,
                                         const float minFaceSize,
                                         const float scaleFactor) {
 
-  cv::Mat rgbImg;
-  if (img.channels() == 3) {
-    cv::cvtColor(img, rgbImg, cv::COLOR_BGR2RGB);
-  } else if (img.channels() == 4) {
-    cv::cvtColor(img, rgbImg, cv::COLOR_BGRA2RGB);
-  }
-  if (rgbImg.empty()) {
+  // The networks take the transposed RGB image. The PNet pyramid and the
+  // RNet / ONet input blobs read the BGR frame directly and do the channel
+  // swap and the transpose while packing, so the cascade below works in
+  // transposed coordinates.
+  if (img.empty() || (img.channels() != 3 && img.channels() != 4)) {
     return std::vector<Face>();
   }
-  rgbImg.convertTo(rgbImg, CV_32FC3);
-  rgbImg = rgbImg.t();
 
   // Run Proposal Network to find the initial set of faces
-  std::vector<Face> faces = _pnet->run(rgbImg, minFaceSize, scaleFactor);
+  std::vector<Face> faces = _pnet->run(img, minFaceSize, scaleFactor);
 
   // Early exit if we do not have any faces
   if (faces.empty()) {
@@ -50,7 +62,7 @@ std::vector<Face> MTCNNDetector::detect(const cv::Mat &img,
   }
 
   // Run Refine network on the output of the Proposal network
-  faces = _rnet->run(rgbImg, faces);
+  faces = _rnet->run(img, faces);
 
   // Early exit if we do not have any faces
   if (faces.empty()) {
@@ -58,8 +70,9 @@ std::vector<Face> MTCNNDetector::detect(const cv::Mat &img,
   }
 
   // Run Output network on the output of the Refine network
-  faces = _onet->run(rgbImg, faces);
+  faces = _onet->run(img, faces);
 
+  // back to frame coordinates
   for (size_t i = 0; i < faces.size(); ++i) {
     std::swap(faces[i].bbox.x1, faces[i].bbox.y1);
     std::swap(faces[i].bbox.x2, faces[i].bbox.y2);
@@ -1,6 +1,7 @@
 #ifndef _include_opencv_mtcnn_face_h_
 #define _include_opencv_mtcnn_face_h_
 
+#include "nms.h"
 #include <opencv2/opencv.hpp>
 
 #define NUM_REGRESSIONS 4
@@ -52,53 +53,19 @@ struct Face {
     }
   }
 
-  static std::vector<Face> runNMS(std::vector<Face> &faces, float threshold,
-                                  bool useMin = false) {
-    std::vector<Face> facesNMS;
-    if (faces.empty()) {
-      return facesNMS;
-    }
-
-    std::sort(faces.begin(), faces.end(), [](const Face &f1, const Face &f2) {
-      return f1.score > f2.score;
-    });
-
-    std::vector<int> indices(faces.size());
-    for (size_t i = 0; i < indices.size(); ++i) {
-      indices[i] = i;
+  static std::vector<Face> runNMS(const std::vector<Face> &faces,
+                                  float threshold, bool useMin = false) {
+    static thread_local NonMaxSuppression nms;
+    nms.clear();
+    for (const Face &f : faces) {
+      nms.add(f.bbox.x1, f.bbox.y1, f.bbox.x2, f.bbox.y2, f.score);
     }
 
-    while (indices.size() > 0) {
-      int idx = indices[0];
+    const std::vector<int> &keep = nms.run(threshold, useMin);
+    std::vector<Face> facesNMS;
+    facesNMS.reserve(keep.size());
+    for (int idx : keep) {
       facesNMS.push_back(faces[idx]);
-      std::vector<int> tmpIndices = indices;
-      indices.clear();
-      for (size_t i = 1; i < tmpIndices.size(); ++i) {
-        int tmpIdx = tmpIndices[i];
-        float interX1 = std::max(faces[idx].bbox.x1, faces[tmpIdx].bbox.x1);
-        float interY1 = std::max(faces[idx].bbox.y1, faces[tmpIdx].bbox.y1);
-        float interX2 = std::min(faces[idx].bbox.x2, faces[tmpIdx].bbox.x2);
-        float interY2 = std::min(faces[idx].bbox.y2, faces[tmpIdx].bbox.y2);
-
-        float bboxWidth = std::max(0.f, (interX2 - interX1 + 1));
-        float bboxHeight = std::max(0.f, (interY2 - interY1 + 1));
-
-        float interArea = bboxWidth * bboxHeight;
-        // TODO: compute outside the loop
-        float area1 = (faces[idx].bbox.x2 - faces[idx].bbox.x1 + 1) *
-                      (faces[idx].bbox.y2 - faces[idx].bbox.y1 + 1);
-        float area2 = (faces[tmpIdx].bbox.x2 - faces[tmpIdx].bbox.x1 + 1) *
-                      (faces[tmpIdx].bbox.y2 - faces[tmpIdx].bbox.y1 + 1);
-        float o = 0.f;
-        if (useMin) {
-          o = interArea / std::min(area1, area2);
-        } else {
-          o = interArea / (area1 + area2 - interArea);
-        }
-        if (o <= threshold) {
-          indices.push_back(tmpIdx);
-        }
-      }
     }
     return facesNMS;
   }
@@ -3,14 +3,15 @@
 
 #include <opencv2/core.hpp>
 
-inline cv::Mat cropImage(const cv::Mat &img, cv::Rect r) {
-  cv::Mat m = cv::Mat::zeros(r.height, r.width, img.type());
-  int dx = std::abs(std::min(0, r.x));
+// Clip r to the part of img that cropImage copies. dx, dy receive the offset
+// of that part inside an r-sized crop, the rest of which is zero padding.
+inline cv::Rect clipCropRect(const cv::Mat &img, cv::Rect r, int &dx, int &dy) {
+  dx = std::abs(std::min(0, r.x));
   if (dx > 0) {
     r.x = 0;
   }
   r.width -= dx;
-  int dy = std::abs(std::min(0, r.y));
+  dy = std::abs(std::min(0, r.y));
   if (dy > 0) {
     r.y = 0;
   }
@@ -19,10 +20,73 @@ inline cv::Mat cropImage(const cv::Mat &img, cv::Rect r) {
   r.width -= dw;
   int dh = std::abs(std::min(0, img.rows - 1 - (r.y + r.height)));
   r.height -= dh;
+  return r;
+}
+
+inline cv::Mat cropImage(const cv::Mat &img, cv::Rect r) {
+  cv::Mat m = cv::Mat::zeros(r.height, r.width, img.type());
+  int dx, dy;
+  r = clipCropRect(img, r, dx, dy);
   if (r.width > 0 && r.height > 0) {
     img(r).copyTo(m(cv::Range(dy, dy + r.height), cv::Range(dx, dx + r.width)));
   }
   return m;
 }
 
+// Normalize the first three channels of an HWC image into three planes
+// starting at dst, as blobFromImage does for a single image. swapRB reverses
+// the channel order (BGR frames to RGB planes) and transpose writes each
+// plane as cols x rows, which is the layout the MTCNN Caffe models expect.
+template <typename T>
+inline void packPlanes(const cv::Mat &img, float mean, float invStddev,
+                       float *dst, bool swapRB = false,
+                       bool transpose = false) {
+  const int cn = img.channels();
+  const size_t plane = static_cast<size_t>(img.rows) * img.cols;
+  float *p0 = dst + (swapRB ? 2 * plane : 0);
+  float *p1 = dst + plane;
+  float *p2 = dst + (swapRB ? 0 : 2 * plane);
+
+  if (!transpose) {
+    for (int y = 0; y < img.rows; ++y) {
+      const T *src = img.ptr<T>(y);
+      const size_t row = static_cast<size_t>(y) * img.cols;
+      for (int x = 0; x < img.cols; ++x, src += cn) {
+        p0[row + x] = (static_cast<float>(src[0]) - mean) * invStddev;
+        p1[row + x] = (static_cast<float>(src[1]) - mean) * invStddev;
+        p2[row + x] = (static_cast<float>(src[2]) - mean) * invStddev;
+      }
+    }
+    return;
+  }
+
+  // go through the image in bands of rows so that every output row is
+  // written in short contiguous runs
+  const int band = 8;
+  for (int y0 = 0; y0 < img.rows; y0 += band) {
+    const int y1 = std::min(y0 + band, img.rows);
+    for (int x = 0; x < img.cols; ++x) {
+      const size_t row = static_cast<size_t>(x) * img.rows;
+      for (int y = y0; y < y1; ++y) {
+        const T *src = img.ptr<T>(y) + x * cn;
+        p0[row + y] = (static_cast<float>(src[0]) - mean) * invStddev;
+        p1[row + y] = (static_cast<float>(src[1]) - mean) * invStddev;
+        p2[row + y] = (static_cast<float>(src[2]) - mean) * invStddev;
+      }
+    }
+  }
+}
+
+inline void packPlanes(const cv::Mat &img, float mean, float invStddev,
+                       float *dst, bool swapRB = false,
+                       bool transpose = false) {
+  CV_Assert((img.depth() == CV_8U || img.depth() == CV_32F) &&
+            img.channels() >= 3);
+  if (img.depth() == CV_8U) {
+    packPlanes<uchar>(img, mean, invStddev, dst, swapRB, transpose);
+  } else {
+    packPlanes<float>(img, mean, invStddev, dst, swapRB, transpose);
+  }
+}
+
 #endif
\ No newline at end of file
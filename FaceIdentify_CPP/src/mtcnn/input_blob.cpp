@@ -0,0 +1,57 @@
+#include "input_blob.h"
+#include "helpers.h"
+#include <opencv2/imgproc.hpp>
+
+InputBlob::InputBlob(int width, int height, float mean, float invStddev)
+    : _width(width), _height(height), _mean(mean), _invStddev(invStddev),
+      _window(width, height, CV_8UC3) {}
+
+void InputBlob::prepare(int n) {
+  size_t size = static_cast<size_t>(n) * 3 * _width * _height;
+  if (_data.size() < size) {
+    _data.resize(size);
+  }
+}
+
+void InputBlob::write(int slot, const cv::Mat &img, const BBox &bbox) {
+  CV_Assert(img.channels() == 3 || img.channels() == 4);
+
+  // bbox is in the transposed coordinates of the networks, r is the same box
+  // in the frame. The clipping rules treat x and y alike, so clipping r gives
+  // the transpose of the crop cropImage would take from the transposed frame.
+  cv::Rect t = bbox.getRect();
+  cv::Rect r(t.y, t.x, t.height, t.width);
+  int dx, dy;
+  cv::Rect visible = clipCropRect(img, r, dx, dy);
+
+  cv::Mat crop;
+  if (visible == r) {
+    // entirely inside the image, resize straight from a view of it
+    crop = img(r);
+  } else {
+    size_t bytes = static_cast<size_t>(r.width) * r.height * img.elemSize();
+    if (_scratch.size() < bytes) {
+      _scratch.resize(bytes);
+    }
+    crop = cv::Mat(r.height, r.width, img.type(), _scratch.data());
+    crop.setTo(cv::Scalar::all(0));
+    if (visible.width > 0 && visible.height > 0) {
+      img(visible).copyTo(
+          crop(cv::Rect(dx, dy, visible.width, visible.height)));
+    }
+  }
+
+  cv::resize(crop, _window, cv::Size(_height, _width), 0, 0, cv::INTER_AREA);
+
+  float *dst = _data.data() + static_cast<size_t>(slot) * 3 * _width * _height;
+  packPlanes(_window, _mean, _invStddev, dst, true, true);
+}
+
+const cv::Mat &InputBlob::blob(int n) {
+  if (_blob.empty() || _blob.size[0] != n ||
+      _blob.ptr<float>() != _data.data()) {
+    int sizes[] = {n, 3, _height, _width};
+    _blob = cv::Mat(4, sizes, CV_32F, _data.data());
+  }
+  return _blob;
+}
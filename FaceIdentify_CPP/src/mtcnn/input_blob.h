@@ -0,0 +1,40 @@
+#ifndef _include_opencv_input_blob_h_
+#define _include_opencv_input_blob_h_
+
+#include "face.h"
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Persistent NCHW float input for the RNet / ONet stages. Each candidate is
+// cropped from the BGR frame, resized and normalized straight into its slot
+// as the transposed RGB window the networks expect, so once the buffer has
+// grown to the largest batch seen no more memory is allocated per frame.
+class InputBlob {
+private:
+  int _width;
+  int _height;
+  float _mean;
+  float _invStddev;
+
+  std::vector<float> _data;
+  std::vector<uchar> _scratch; // zero padded crop for boxes leaving the image
+  cv::Mat _window;             // resized crop, HWC in frame orientation
+  cv::Mat _blob;               // 4D header over _data
+
+public:
+  InputBlob(int width, int height, float mean, float invStddev);
+
+  // Make room for n slots, growing the buffer if needed
+  void prepare(int n);
+
+  // Crop bbox, given in transposed coordinates, out of the BGR / BGRA frame
+  // img the way cropImage does, resize it to the network input size and
+  // store it normalized in slot
+  void write(int slot, const cv::Mat &img, const BBox &bbox);
+
+  // The first n slots as an n x 3 x height x width blob, valid until the next
+  // prepare()
+  const cv::Mat &blob(int n);
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "nms.h"
+#include <algorithm>
+#include <numeric>
+
+void NonMaxSuppression::clear() {
+  _x1.clear();
+  _y1.clear();
+  _x2.clear();
+  _y2.clear();
+  _score.clear();
+}
+
+void NonMaxSuppression::reserve(size_t n) {
+  _x1.reserve(n);
+  _y1.reserve(n);
+  _x2.reserve(n);
+  _y2.reserve(n);
+  _score.reserve(n);
+}
+
+void NonMaxSuppression::add(float x1, float y1, float x2, float y2,
+                            float score) {
+  _x1.push_back(x1);
+  _y1.push_back(y1);
+  _x2.push_back(x2);
+  _y2.push_back(y2);
+  _score.push_back(score);
+}
+
+template <bool UseMin>
+void NonMaxSuppression::suppress(size_t p, size_t begin, size_t end,
+                                 float threshold) {
+  const float *x1 = _sx1.data();
+  const float *y1 = _sy1.data();
+  const float *x2 = _sx2.data();
+  const float *y2 = _sy2.data();
+  const float *area = _sarea.data();
+  const int *rank = _srank.data();
+  uint8_t *suppressed = _suppressed.data();
+
+  const float bx1 = x1[p], by1 = y1[p], bx2 = x2[p], by2 = y2[p];
+  const float barea = area[p];
+  const int brank = rank[p];
+
+  for (size_t j = begin; j < end; ++j) {
+    float w = std::max(0.f, std::min(bx2, x2[j]) - std::max(bx1, x1[j]) + 1);
+    float h = std::max(0.f, std::min(by2, y2[j]) - std::max(by1, y1[j]) + 1);
+    float inter = w * h;
+    float denom = UseMin ? std::min(barea, area[j]) : barea + area[j] - inter;
+    // inter / denom > threshold, without the division
+    bool overlaps = (inter > threshold * denom) & (rank[j] > brank);
+    suppressed[j] |= static_cast<uint8_t>(overlaps);
+  }
+}
+
+const std::vector<int> &NonMaxSuppression::run(float threshold,
+                                               bool useMin) {
+  const size_t n = _x1.size();
+
+  _byScore.resize(n);
+  std::iota(_byScore.begin(), _byScore.end(), 0);
+  std::sort(_byScore.begin(), _byScore.end(), [this](int a, int b) {
+    return _score[a] > _score[b] || (_score[a] == _score[b] && a < b);
+  });
+
+  _byX.resize(n);
+  std::iota(_byX.begin(), _byX.end(), 0);
+  std::sort(_byX.begin(), _byX.end(),
+            [this](int a, int b) { return _x1[a] < _x1[b]; });
+
+  _pos.resize(n);
+  _sx1.resize(n);
+  _sy1.resize(n);
+  _sx2.resize(n);
+  _sy2.resize(n);
+  _sarea.resize(n);
+  _srank.resize(n);
+  float maxWidth = 0.f;
+  for (size_t p = 0; p < n; ++p) {
+    int i = _byX[p];
+    _pos[i] = p;
+    _sx1[p] = _x1[i];
+    _sy1[p] = _y1[i];
+    _sx2[p] = _x2[i];
+    _sy2[p] = _y2[i];
+    _sarea[p] = (_x2[i] - _x1[i] + 1) * (_y2[i] - _y1[i] + 1);
+    maxWidth = std::max(maxWidth, _x2[i] - _x1[i]);
+  }
+  for (size_t r = 0; r < n; ++r) {
+    _srank[_pos[_byScore[r]]] = r;
+  }
+
+  _suppressed.assign(n, 0);
+  _keep.clear();
+  for (size_t r = 0; r < n; ++r) {
+    const size_t p = _pos[_byScore[r]];
+    if (_suppressed[p]) {
+      continue;
+    }
+    _keep.push_back(_byScore[r]);
+
+    // only boxes starting within maxWidth + 1 left of this one up to its
+    // right edge can intersect it
+    size_t begin = std::lower_bound(_sx1.begin(), _sx1.end(),
+                                    _sx1[p] - maxWidth - 1) -
+                   _sx1.begin();
+    size_t end = std::upper_bound(_sx1.begin() + p, _sx1.end(), _sx2[p] + 1) -
+                 _sx1.begin();
+    if (useMin) {
+      suppress<true>(p, begin, end, threshold);
+    } else {
+      suppress<false>(p, begin, end, threshold);
+    }
+  }
+  return _keep;
+}
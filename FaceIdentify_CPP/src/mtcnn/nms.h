@@ -0,0 +1,52 @@
+#ifndef _include_opencv_nms_h_
+#define _include_opencv_nms_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Greedy non-maximum suppression over boxes held as separate coordinate
+// arrays. The boxes are ranked by score and sorted by x1 once, and their
+// areas computed once. Every kept box then only visits the x1-sorted window
+// of boxes that can reach it, marking overlapped lower ranked boxes in a
+// suppression mask with a branch-free loop the compiler vectorizes. Scratch
+// buffers are kept between calls, so a reused instance does not allocate in
+// steady state.
+class NonMaxSuppression {
+private:
+  // boxes as added
+  std::vector<float> _x1, _y1, _x2, _y2, _score;
+
+  std::vector<int> _byScore; // box indices, highest score first
+  std::vector<int> _byX;     // box indices, ascending x1
+  std::vector<int> _pos;     // position of each box in _byX
+
+  // boxes in x1 order
+  std::vector<float> _sx1, _sy1, _sx2, _sy2, _sarea;
+  std::vector<int> _srank;
+  std::vector<uint8_t> _suppressed;
+
+  std::vector<int> _keep;
+
+private:
+  // Mark the boxes in [begin, end) of the x1 order that rank below the box
+  // at position p and overlap it
+  template <bool UseMin>
+  void suppress(size_t p, size_t begin, size_t end, float threshold);
+
+public:
+  void clear();
+  void reserve(size_t n);
+
+  void add(float x1, float y1, float x2, float y2, float score);
+
+  size_t size() const { return _x1.size(); }
+
+  // Indices, in the order boxes were added, of the boxes that survive,
+  // highest score first. A box is dropped when its overlap with a higher
+  // scoring box is above threshold, measured against the union of the two
+  // or, with useMin, against the smaller box.
+  const std::vector<int> &run(float threshold, bool useMin = false);
+};
+
+#endif
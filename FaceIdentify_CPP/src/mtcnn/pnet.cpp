@@ -1,4 +1,12 @@
 #include "pnet.h"
+#include <array>
+#include <atomic>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 const float P_NET_WINDOW_SIZE = 12.f;
 const int P_NET_STRIDE = 2;
@@ -6,101 +14,200 @@ const int P_NET_STRIDE = 2;
 const float IMG_MEAN = 127.5f;
 const float IMG_INV_STDDEV = 1.f / 128.f;
 
-ProposalNetwork::ProposalNetwork(const ProposalNetwork::Config &config) {
-  _net = cv::dnn::readNetFromCaffe(config.protoText, config.caffeModel);
-  if (_net.empty()) {
-    throw std::invalid_argument("invalid protoText or caffeModel for PNet");
+const std::vector<StageNet::Output> OUTPUTS{{"conv4-2", 4}, {"prob1", 2}};
+
+// Room findCells may write past the last index it returns
+const size_t CELLS_PADDING = 8;
+
+// Store the indices of the scores at or above threshold in out, in
+// ascending order, and return how many there are. out must have room for
+// n + CELLS_PADDING indices.
+static size_t findCells(const float *scores, size_t n, float threshold,
+                        int *out) {
+  size_t i = 0;
+  size_t count = 0;
+#if defined(__AVX2__)
+  // lane offsets of the set bits of every 8 bit compare mask, packed to
+  // the front
+  alignas(32) static const std::array<std::array<int32_t, 8>, 256> lanes = [] {
+    std::array<std::array<int32_t, 8>, 256> t{};
+    for (int mask = 0; mask < 256; ++mask) {
+      int k = 0;
+      for (int bit = 0; bit < 8; ++bit) {
+        if (mask & (1 << bit)) {
+          t[mask][k++] = bit;
+        }
+      }
+    }
+    return t;
+  }();
+
+  const __m256 t = _mm256_set1_ps(threshold);
+  for (; i + 8 <= n; i += 8) {
+    int mask = _mm256_movemask_ps(
+        _mm256_cmp_ps(_mm256_loadu_ps(scores + i), t, _CMP_GE_OQ));
+    __m256i idx = _mm256_add_epi32(
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(lanes[mask].data())),
+        _mm256_set1_epi32(static_cast<int>(i)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + count), idx);
+    count += __builtin_popcount(mask);
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const float32x4_t t = vdupq_n_f32(threshold);
+  for (; i + 4 <= n; i += 4) {
+    if (vmaxvq_u32(vcgeq_f32(vld1q_f32(scores + i), t)) == 0) {
+      continue;
+    }
+    for (size_t k = i; k < i + 4; ++k) {
+      out[count] = static_cast<int>(k);
+      count += scores[k] >= threshold;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    out[count] = static_cast<int>(i);
+    count += scores[i] >= threshold;
+  }
+  return count;
+}
+
+ProposalNetwork::ProposalNetwork(const ProposalNetwork::Config &config)
+    : _pyramid(IMG_MEAN, IMG_INV_STDDEV) {
+  if (config.threads < 0) {
+    throw std::invalid_argument("PNet threads must not be negative");
+  }
+  int threads = config.threads == 0 ? cv::getNumberOfCPUs() : config.threads;
+
+  // neither backend can run one network from several threads, so every
+  // level that may run concurrently gets its own copy of the network
+  _workers.resize(threads);
+  for (Worker &worker : _workers) {
+    worker.net = StageNet::create(config.model, OUTPUTS, "PNet");
   }
   _threshold = config.threshold;
 }
 
 ProposalNetwork::~ProposalNetwork() {}
 
-std::vector<Face> ProposalNetwork::buildFaces(const cv::Mat &scores,
+std::vector<Face> ProposalNetwork::buildFaces(Worker &worker,
+                                              const cv::Mat &scores,
                                               const cv::Mat &regressions,
                                               const float scaleFactor,
                                               const float threshold) {
 
-  auto w = scores.size[3];
-  auto h = scores.size[2];
-  auto size = w * h;
+  const int w = scores.size[3];
+  const int h = scores.size[2];
+  const size_t size = static_cast<size_t>(w) * h;
 
   const float *scores_data = (float *)(scores.data);
   scores_data += size;
 
   const float *reg_data = (float *)(regressions.data);
 
-  std::vector<Face> boxes;
+  auto cellBox = [&](int i) {
+    int y = i / w;
+    int x = i - w * y;
+    BBox box;
+    box.x1 = (float)(x * P_NET_STRIDE) / scaleFactor;
+    box.y1 = (float)(y * P_NET_STRIDE) / scaleFactor;
+    box.x2 = (float)(x * P_NET_STRIDE + P_NET_WINDOW_SIZE - 1.f) / scaleFactor;
+    box.y2 = (float)(y * P_NET_STRIDE + P_NET_WINDOW_SIZE - 1.f) / scaleFactor;
+    return box;
+  };
+
+  if (worker.cells.size() < size + CELLS_PADDING) {
+    worker.cells.resize(size + CELLS_PADDING);
+  }
+  const size_t count =
+      findCells(scores_data, size, threshold, worker.cells.data());
+
+  // the candidates only live in the NMS arrays, Face objects are built for
+  // the boxes that survive
+  NonMaxSuppression &nms = worker.nms;
+  nms.clear();
+  nms.reserve(count);
+  for (size_t k = 0; k < count; ++k) {
+    int i = worker.cells[k];
+    BBox box = cellBox(i);
+    nms.add(box.x1, box.y1, box.x2, box.y2, scores_data[i]);
+  }
 
-  for (int i = 0; i < size; i++) {
-    if (scores_data[i] >= (threshold)) {
-      int y = i / w;
-      int x = i - w * y;
-
-      Face faceInfo;
-      BBox &faceBox = faceInfo.bbox;
-
-      faceBox.x1 = (float)(x * P_NET_STRIDE) / scaleFactor;
-      faceBox.y1 = (float)(y * P_NET_STRIDE) / scaleFactor;
-      faceBox.x2 =
-          (float)(x * P_NET_STRIDE + P_NET_WINDOW_SIZE - 1.f) / scaleFactor;
-      faceBox.y2 =
-          (float)(y * P_NET_STRIDE + P_NET_WINDOW_SIZE - 1.f) / scaleFactor;
-      faceInfo.regression[0] = reg_data[i];
-      faceInfo.regression[1] = reg_data[i + size];
-      faceInfo.regression[2] = reg_data[i + 2 * size];
-      faceInfo.regression[3] = reg_data[i + 3 * size];
-      faceInfo.score = scores_data[i];
-      boxes.push_back(faceInfo);
-    }
+  const std::vector<int> &keep = nms.run(0.5f);
+  std::vector<Face> boxes;
+  boxes.reserve(keep.size());
+  for (int k : keep) {
+    int i = worker.cells[k];
+
+    Face faceInfo;
+    faceInfo.bbox = cellBox(i);
+    faceInfo.regression[0] = reg_data[i];
+    faceInfo.regression[1] = reg_data[i + size];
+    faceInfo.regression[2] = reg_data[i + 2 * size];
+    faceInfo.regression[3] = reg_data[i + 3 * size];
+    faceInfo.score = scores_data[i];
+    boxes.push_back(faceInfo);
   }
 
   return boxes;
 }
 
+std::vector<Face> ProposalNetwork::runLevel(Worker &worker, size_t level,
+                                            const float scale) {
+  // feed it to the proposal network
+  worker.net->forward(_pyramid.blob(level), worker.outputBlobs);
+
+  const cv::Mat &regressionsBlob = worker.outputBlobs[0];
+  const cv::Mat &scoresBlob = worker.outputBlobs[1];
+
+  // threshold and per level nms
+  return buildFaces(worker, scoresBlob, regressionsBlob, scale, _threshold);
+}
+
 std::vector<Face> ProposalNetwork::run(const cv::Mat &img,
                                        const float minFaceSize,
                                        const float scaleFactor) {
 
-  std::vector<Face> finalFaces;
+  std::vector<float> scales;
   float maxFaceSize = static_cast<float>(std::min(img.rows, img.cols));
   float faceSize = minFaceSize;
 
   while (faceSize <= maxFaceSize) {
-    float currentScale = (P_NET_WINDOW_SIZE) / faceSize;
-    int imgHeight = std::ceil(img.rows * currentScale);
-    int imgWidth = std::ceil(img.cols * currentScale);
-    cv::Mat resizedImg;
-    cv::resize(img, resizedImg, cv::Size(imgWidth, imgHeight), 0, 0,
-               cv::INTER_AREA);
-
-    // feed it to the proposal network
-    cv::Mat inputBlob =
-        cv::dnn::blobFromImage(resizedImg, IMG_INV_STDDEV, cv::Size(),
-                               cv::Scalar(IMG_MEAN, IMG_MEAN, IMG_MEAN), false);
-
-    _net.setInput(inputBlob, "data");
-
-    const std::vector<cv::String> outBlobNames{"conv4-2", "prob1"};
-    std::vector<cv::Mat> outputBlobs;
-
-    _net.forward(outputBlobs, outBlobNames);
-
-    cv::Mat regressionsBlob = outputBlobs[0];
-    cv::Mat scoresBlob = outputBlobs[1];
-
-    auto faces =
-        buildFaces(scoresBlob, regressionsBlob, currentScale, _threshold);
-
-    if (!faces.empty()) {
-      faces = Face::runNMS(faces, 0.5f);
-    }
+    scales.push_back(P_NET_WINDOW_SIZE / faceSize);
+    faceSize /= scaleFactor;
+  }
 
-    if (!faces.empty()) {
-      finalFaces.insert(finalFaces.end(), faces.begin(), faces.end());
+  _pyramid.build(img, scales);
+
+  std::vector<std::vector<Face>> levelFaces(scales.size());
+  const int stripes =
+      static_cast<int>(std::min(_workers.size(), scales.size()));
+
+  if (stripes > 1) {
+    // every stripe owns one worker and keeps taking the next level, largest
+    // first, so the big levels start early and the small ones fill the gaps
+    std::atomic<size_t> nextLevel(0);
+    cv::parallel_for_(
+        cv::Range(0, stripes),
+        [&](const cv::Range &range) {
+          for (int s = range.start; s < range.end; ++s) {
+            for (size_t level = nextLevel++; level < scales.size();
+                 level = nextLevel++) {
+              levelFaces[level] = runLevel(_workers[s], level, scales[level]);
+            }
+          }
+        },
+        stripes);
+  } else {
+    for (size_t level = 0; level < scales.size(); ++level) {
+      levelFaces[level] = runLevel(_workers[0], level, scales[level]);
     }
+  }
 
-    faceSize /= scaleFactor;
+  // merge in level order so the final NMS sees the same input as the
+  // serial loop did
+  std::vector<Face> finalFaces;
+  for (auto &faces : levelFaces) {
+    finalFaces.insert(finalFaces.end(), faces.begin(), faces.end());
   }
 
   if (!finalFaces.empty()) {
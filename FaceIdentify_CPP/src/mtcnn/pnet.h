@@ -2,27 +2,39 @@
 #define _include_opencv_pnet_h_
 
 #include "face.h"
-#include <opencv2/dnn.hpp>
+#include "pyramid.h"
+#include "stage_net.h"
 
 class ProposalNetwork {
 public:
   struct Config {
   public:
-    std::string protoText;
-    std::string caffeModel;
+    StageNet::Model model;
     float threshold;
     float nmsThreshold;
+    int threads; // pyramid levels run concurrently, 0 uses every core
   };
 
 private:
-  cv::dnn::Net _net;
+  // State of one concurrently running level
+  struct Worker {
+    std::unique_ptr<StageNet> net;
+    std::vector<cv::Mat> outputBlobs;
+    std::vector<int> cells; // above-threshold cells of the score map
+    NonMaxSuppression nms;  // candidate boxes of the level
+  };
+
+  std::vector<Worker> _workers;
   float _threshold;
+  ImagePyramid _pyramid;
 
 private:
-  std::vector<Face> buildFaces(const cv::Mat &scores,
+  std::vector<Face> buildFaces(Worker &worker, const cv::Mat &scores,
                                const cv::Mat &regressions,
                                const float scaleFactor, const float threshold);
 
+  std::vector<Face> runLevel(Worker &worker, size_t level, const float scale);
+
 public:
   ProposalNetwork(const ProposalNetwork::Config &config);
   ~ProposalNetwork();
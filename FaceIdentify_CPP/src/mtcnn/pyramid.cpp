@@ -0,0 +1,49 @@
+#include "pyramid.h"
+#include "helpers.h"
+#include <opencv2/imgproc.hpp>
+
+ImagePyramid::ImagePyramid(float mean, float invStddev)
+    : _mean(mean), _invStddev(invStddev) {}
+
+void ImagePyramid::build(const cv::Mat &img, const std::vector<float> &scales) {
+  CV_Assert((img.depth() == CV_8U || img.depth() == CV_32F) &&
+            (img.channels() == 3 || img.channels() == 4));
+
+  if (_levels.size() < scales.size()) {
+    _levels.resize(scales.size());
+  }
+  _numLevels = scales.size();
+
+  for (size_t i = 0; i < scales.size(); ++i) {
+    Level &level = _levels[i];
+    level.scale = scales[i];
+    cv::Size size(std::ceil(img.cols * scales[i]),
+                  std::ceil(img.rows * scales[i]));
+
+    // shrink the previous level when it is already a downscale of the
+    // frame, upscaled levels are taken from the frame itself
+    const cv::Mat &src =
+        (i > 0 && _levels[i - 1].scale <= 1.f) ? _levels[i - 1].image : img;
+    cv::resize(src, level.image, size, 0, 0, cv::INTER_AREA);
+  }
+}
+
+const cv::Mat &ImagePyramid::blob(size_t level) {
+  Level &l = _levels[level];
+  const int rows = l.image.rows;
+  const int cols = l.image.cols;
+
+  size_t size = static_cast<size_t>(3) * rows * cols;
+  if (l.data.size() < size) {
+    l.data.resize(size);
+  }
+  packPlanes(l.image, _mean, _invStddev, l.data.data(), true, true);
+
+  // the planes are transposed, cols x rows
+  if (l.blob.empty() || l.blob.size[2] != cols || l.blob.size[3] != rows ||
+      l.blob.ptr<float>() != l.data.data()) {
+    int sizes[] = {1, 3, cols, rows};
+    l.blob = cv::Mat(4, sizes, CV_32F, l.data.data());
+  }
+  return l.blob;
+}
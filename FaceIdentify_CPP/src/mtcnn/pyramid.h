@@ -0,0 +1,40 @@
+#ifndef _include_opencv_pyramid_h_
+#define _include_opencv_pyramid_h_
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Image pyramid for the PNet scales. Every level is resized from the
+// previous one instead of from the full frame, in the depth of the input
+// (8-bit frames stay 8-bit), and normalized straight into its NCHW blob as
+// the transposed RGB image the network expects.
+// Level images and blobs are kept across frames, so a stream of frames of
+// the same size does not allocate.
+class ImagePyramid {
+private:
+  struct Level {
+    float scale;
+    cv::Mat image;           // resized HWC image
+    std::vector<float> data; // normalized NCHW planes
+    cv::Mat blob;            // 4D header over data
+  };
+
+  float _mean;
+  float _invStddev;
+  std::vector<Level> _levels;
+  size_t _numLevels = 0;
+
+public:
+  ImagePyramid(float mean, float invStddev);
+
+  // Resize the BGR / BGRA frame img to every scale, largest scale first
+  void build(const cv::Mat &img, const std::vector<float> &scales);
+
+  size_t levels() const { return _numLevels; }
+
+  // Normalized 1 x 3 x w x h blob of level. Different levels may be packed
+  // from different threads at once.
+  const cv::Mat &blob(size_t level);
+};
+
+#endif
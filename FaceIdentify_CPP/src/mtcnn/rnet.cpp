@@ -7,55 +7,48 @@ const int INPUT_DATA_HEIGHT = 24;
 const float IMG_MEAN = 127.5f;
 const float IMG_INV_STDDEV = 1.f / 128.f;
 
-RefineNetwork::RefineNetwork(const RefineNetwork::Config &config) {
-  _net = cv::dnn::readNetFromCaffe(config.protoText, config.caffeModel);
-  if (_net.empty()) {
-    throw std::invalid_argument("invalid protoText or caffeModel for RNet");
+const std::vector<StageNet::Output> OUTPUTS{{"conv5-2", 4}, {"prob1", 2}};
+
+RefineNetwork::RefineNetwork(const RefineNetwork::Config &config)
+    : _input(INPUT_DATA_WIDTH, INPUT_DATA_HEIGHT, IMG_MEAN, IMG_INV_STDDEV) {
+  _net = StageNet::create(config.model, OUTPUTS, "RNet");
+  if (config.maxBatch < 1) {
+    throw std::invalid_argument("RNet maxBatch must be at least 1");
   }
   _threshold = config.threshold;
+  _maxBatch = config.maxBatch;
 }
 
 RefineNetwork::~RefineNetwork() {}
 
 std::vector<Face> RefineNetwork::run(const cv::Mat &img,
                                      const std::vector<Face> &faces) {
-  cv::Size windowSize = cv::Size(INPUT_DATA_WIDTH, INPUT_DATA_HEIGHT);
-
-  std::vector<cv::Mat> inputs;
-  for (auto &f : faces) {
-    cv::Mat roi = cropImage(img, f.bbox.getRect());
-    cv::resize(roi, roi, windowSize, 0, 0, cv::INTER_AREA);
-    inputs.push_back(roi);
-  }
-
-  // build blob images from the inputs
-  auto blobInputs =
-      cv::dnn::blobFromImages(inputs, IMG_INV_STDDEV, cv::Size(),
-                              cv::Scalar(IMG_MEAN, IMG_MEAN, IMG_MEAN), false);
-
-  _net.setInput(blobInputs, "data");
-
-  const std::vector<cv::String> outBlobNames{"conv5-2", "prob1"};
-  std::vector<cv::Mat> outputBlobs;
+  std::vector<Face> totalFaces;
 
-  _net.forward(outputBlobs, outBlobNames);
+  const int numFaces = static_cast<int>(faces.size());
+  _input.prepare(std::min(numFaces, _maxBatch));
 
-  cv::Mat regressionsBlob = outputBlobs[0];
-  cv::Mat scoresBlob = outputBlobs[1];
+  // run the candidates through the network maxBatch at a time
+  for (int begin = 0; begin < numFaces; begin += _maxBatch) {
+    const int n = std::min(_maxBatch, numFaces - begin);
+    for (int k = 0; k < n; ++k) {
+      _input.write(k, img, faces[begin + k].bbox);
+    }
 
-  std::vector<Face> totalFaces;
+    _net->forward(_input.blob(n), _outputBlobs);
 
-  const float *scores_data = (float *)scoresBlob.data;
-  const float *reg_data = (float *)regressionsBlob.data;
+    const float *reg_data = (float *)_outputBlobs[0].data;
+    const float *scores_data = (float *)_outputBlobs[1].data;
 
-  for (int k = 0; k < faces.size(); ++k) {
-    if (scores_data[2 * k + 1] >= _threshold) {
-      Face info = faces[k];
-      info.score = scores_data[2 * k + 1];
-      for (int i = 0; i < 4; ++i) {
-        info.regression[i] = reg_data[4 * k + i];
+    for (int k = 0; k < n; ++k) {
+      if (scores_data[2 * k + 1] >= _threshold) {
+        Face info = faces[begin + k];
+        info.score = scores_data[2 * k + 1];
+        for (int i = 0; i < 4; ++i) {
+          info.regression[i] = reg_data[4 * k + i];
+        }
+        totalFaces.push_back(info);
       }
-      totalFaces.push_back(info);
     }
   }
 
@@ -2,20 +2,24 @@
 #define _include_opencv_rnet_h_
 
 #include "face.h"
-#include <opencv2/dnn.hpp>
+#include "input_blob.h"
+#include "stage_net.h"
 
 class RefineNetwork {
 public:
   struct Config {
   public:
-    std::string protoText;
-    std::string caffeModel;
+    StageNet::Model model;
     float threshold;
+    int maxBatch; // candidates per forward pass
   };
 
 private:
-  cv::dnn::Net _net;
+  std::unique_ptr<StageNet> _net;
   float _threshold;
+  int _maxBatch;
+  InputBlob _input;
+  std::vector<cv::Mat> _outputBlobs;
 
 public:
   RefineNetwork(const RefineNetwork::Config &config);
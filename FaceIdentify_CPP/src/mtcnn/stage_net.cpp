@@ -0,0 +1,192 @@
+#include "stage_net.h"
+#include <cstring>
+#include <opencv2/dnn.hpp>
+#include <stdexcept>
+#include <tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h>
+#include <tensorflow/lite/interpreter.h>
+#include <tensorflow/lite/kernels/register.h>
+#include <tensorflow/lite/model.h>
+
+class CaffeStageNet : public StageNet {
+private:
+  cv::dnn::Net _net;
+  std::vector<cv::String> _outBlobNames;
+
+public:
+  CaffeStageNet(const Model &model, const std::vector<Output> &outputs,
+                const std::string &name) {
+    _net = cv::dnn::readNetFromCaffe(model.protoText, model.caffeModel);
+    if (_net.empty()) {
+      throw std::invalid_argument("invalid protoText or caffeModel for " +
+                                  name);
+    }
+    for (const Output &output : outputs) {
+      _outBlobNames.push_back(output.name);
+    }
+  }
+
+  void forward(const cv::Mat &blob, std::vector<cv::Mat> &outputs) override {
+    _net.setInput(blob, "data");
+    _net.forward(outputs, _outBlobNames);
+  }
+};
+
+class TfLiteStageNet : public StageNet {
+private:
+  std::string _name;
+  std::unique_ptr<tflite::FlatBufferModel> _model;
+  // declared before the interpreter, which must be destroyed first
+  std::unique_ptr<TfLiteDelegate, void (*)(TfLiteDelegate *)> _delegate;
+  std::unique_ptr<tflite::Interpreter> _interpreter;
+
+  std::vector<int> _channels;    // channel count of every requested output
+  std::vector<int> _outputIndex; // interpreter tensor of every output
+  std::vector<int> _shape;       // current NHWC input shape
+  std::vector<std::vector<float>> _outputData;
+
+private:
+  void resize(const std::vector<int> &shape) {
+    const int input = _interpreter->inputs()[0];
+    if (_interpreter->ResizeInputTensor(input, shape) != kTfLiteOk ||
+        _interpreter->AllocateTensors() != kTfLiteOk) {
+      throw std::runtime_error(_name + " failed to resize input tensor");
+    }
+    _shape = shape;
+
+    // the converted models name their outputs StatefulPartitionedCall:N,
+    // so match them by channel count instead
+    _outputIndex.clear();
+    for (int channels : _channels) {
+      int found = -1;
+      for (int idx : _interpreter->outputs()) {
+        const TfLiteTensor *t = _interpreter->tensor(idx);
+        if (t->dims->size > 0 &&
+            t->dims->data[t->dims->size - 1] == channels) {
+          found = idx;
+          break;
+        }
+      }
+      if (found < 0) {
+        throw std::runtime_error(_name + " tflite model has no output with " +
+                                 std::to_string(channels) + " channels");
+      }
+      _outputIndex.push_back(found);
+    }
+  }
+
+public:
+  TfLiteStageNet(const Model &model, const std::vector<Output> &outputs,
+                 const std::string &name)
+      : _name(name), _delegate(nullptr, TfLiteXNNPackDelegateDelete) {
+    _model = tflite::FlatBufferModel::BuildFromFile(model.tfliteModel.c_str());
+    if (!_model) {
+      throw std::invalid_argument("invalid tflite model for " + name);
+    }
+
+    // delegates are applied explicitly below, not by the resolver
+    tflite::ops::builtin::BuiltinOpResolverWithoutDefaultDelegates resolver;
+    tflite::InterpreterBuilder builder(*_model, resolver);
+    builder(&_interpreter);
+    if (!_interpreter) {
+      throw std::runtime_error("Failed to create " + name +
+                               " tflite interpreter");
+    }
+    _interpreter->SetNumThreads(model.threads);
+
+    if (model.xnnpack) {
+      TfLiteXNNPackDelegateOptions options =
+          TfLiteXNNPackDelegateOptionsDefault();
+      options.num_threads = model.threads;
+      _delegate.reset(TfLiteXNNPackDelegateCreate(&options));
+      if (!_delegate ||
+          _interpreter->ModifyGraphWithDelegate(_delegate.get()) !=
+              kTfLiteOk) {
+        throw std::runtime_error("Failed to apply XNNPACK delegate to " + name);
+      }
+    }
+
+    for (const Output &output : outputs) {
+      _channels.push_back(output.channels);
+    }
+    _outputData.resize(outputs.size());
+  }
+
+  void forward(const cv::Mat &blob, std::vector<cv::Mat> &outputs) override {
+    CV_Assert(blob.dims == 4 && blob.type() == CV_32F && blob.isContinuous());
+    const int n = blob.size[0];
+    const int c = blob.size[1];
+    const int h = blob.size[2];
+    const int w = blob.size[3];
+
+    // PNet gets a new size for every pyramid level, RNet / ONet for every
+    // batch size
+    if (_shape.size() != 4 || _shape[0] != n || _shape[1] != h ||
+        _shape[2] != w || _shape[3] != c) {
+      resize({n, h, w, c});
+    }
+
+    // NCHW to NHWC
+    const size_t plane = static_cast<size_t>(h) * w;
+    const float *src = blob.ptr<float>();
+    float *dst = _interpreter->typed_input_tensor<float>(0);
+    for (int b = 0; b < n; ++b) {
+      for (int ch = 0; ch < c; ++ch) {
+        const float *p = src + (static_cast<size_t>(b) * c + ch) * plane;
+        float *q = dst + static_cast<size_t>(b) * c * plane + ch;
+        for (size_t i = 0; i < plane; ++i) {
+          q[i * c] = p[i];
+        }
+      }
+    }
+
+    if (_interpreter->Invoke() != kTfLiteOk) {
+      throw std::runtime_error(_name + " failed to invoke interpreter");
+    }
+
+    outputs.resize(_outputIndex.size());
+    for (size_t k = 0; k < _outputIndex.size(); ++k) {
+      const TfLiteTensor *t = _interpreter->tensor(_outputIndex[k]);
+      std::vector<float> &data = _outputData[k];
+      const size_t count = t->bytes / sizeof(float);
+      if (data.size() < count) {
+        data.resize(count);
+      }
+
+      if (t->dims->size == 4) {
+        // NHWC maps back to NCHW
+        const int on = t->dims->data[0];
+        const int oh = t->dims->data[1];
+        const int ow = t->dims->data[2];
+        const int oc = t->dims->data[3];
+        const size_t oplane = static_cast<size_t>(oh) * ow;
+        for (int b = 0; b < on; ++b) {
+          for (int ch = 0; ch < oc; ++ch) {
+            const float *p =
+                t->data.f + static_cast<size_t>(b) * oc * oplane + ch;
+            float *q =
+                data.data() + (static_cast<size_t>(b) * oc + ch) * oplane;
+            for (size_t i = 0; i < oplane; ++i) {
+              q[i] = p[i * oc];
+            }
+          }
+        }
+        int sizes[] = {on, oc, oh, ow};
+        outputs[k] = cv::Mat(4, sizes, CV_32F, data.data());
+      } else {
+        std::memcpy(data.data(), t->data.f, count * sizeof(float));
+        const int rows = t->dims->data[0];
+        outputs[k] = cv::Mat(rows, static_cast<int>(count / rows), CV_32F,
+                             data.data());
+      }
+    }
+  }
+};
+
+std::unique_ptr<StageNet> StageNet::create(const Model &model,
+                                           const std::vector<Output> &outputs,
+                                           const std::string &name) {
+  if (model.backend == Backend::TFLITE) {
+    return std::make_unique<TfLiteStageNet>(model, outputs, name);
+  }
+  return std::make_unique<CaffeStageNet>(model, outputs, name);
+}
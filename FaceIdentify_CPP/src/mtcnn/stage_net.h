@@ -0,0 +1,45 @@
+#ifndef _include_opencv_stage_net_h_
+#define _include_opencv_stage_net_h_
+
+#include <memory>
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+// Inference backend of one MTCNN network. forward() takes a batch of
+// transposed RGB windows packed NCHW, as built by ImagePyramid and
+// InputBlob, and returns the outputs in the layout of the Caffe models:
+// NCHW maps for PNet, one row per window for RNet and ONet.
+class StageNet {
+public:
+  enum class Backend { CAFFE, TFLITE };
+
+  struct Model {
+  public:
+    Backend backend;
+    std::string protoText;   // CAFFE
+    std::string caffeModel;  // CAFFE
+    std::string tfliteModel; // TFLITE
+    int threads;             // TFLITE interpreter threads
+    bool xnnpack;            // TFLITE, run on the XNNPACK delegate
+  };
+
+  // A network output, by its Caffe blob name and by its channel count, which
+  // is what tells the outputs of the TFLite conversions apart
+  struct Output {
+    cv::String name;
+    int channels;
+  };
+
+public:
+  virtual ~StageNet() {}
+
+  virtual void forward(const cv::Mat &blob, std::vector<cv::Mat> &outputs) = 0;
+
+  // name is used in error messages, e.g. "PNet"
+  static std::unique_ptr<StageNet> create(const Model &model,
+                                          const std::vector<Output> &outputs,
+                                          const std::string &name);
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef __test_common_hpp__
+#define __test_common_hpp__
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+
+// Minimal test harness: TEST(name) registers a case, CHECK records a failure and carries on,
+// every test program ends with `int main() { return test::run(); }`
+namespace test {
+
+struct Case {
+    const char* name;
+    void (*fn)();
+};
+
+inline std::vector<Case>& cases() {
+    static std::vector<Case> registered;
+    return registered;
+}
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+struct Register {
+    Register(const char* name, void (*fn)()) { cases().push_back({name, fn}); }
+};
+
+inline int run() {
+    for (const Case& c : cases()) {
+        int before = failures();
+        c.fn();
+        std::printf("%s %s\n", failures() == before ? "PASS" : "FAIL", c.name);
+    }
+    return failures() == 0 ? 0 : 1;
+}
+
+// Path of a scratch file in the temp directory, unique per process
+inline std::string temp_path(const std::string& name) {
+    return (std::filesystem::temp_directory_path() /
+            ("faceidentify_test_" + std::to_string(::getpid()) + "_" + name)).string();
+}
+
+// Remove filename and the files stored next to it
+inline void remove_files(const std::string& filename) {
+    for (const char* suffix : {"", ".tmp", ".hnsw", ".hnsw.tmp", ".wal", ".wal.tmp"}) {
+        std::filesystem::remove(filename + suffix);
+    }
+}
+
+// n x dim row-major floats, unit-normalized
+inline std::vector<float> random_rows(size_t n, size_t dim, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist;
+    std::vector<float> rows(n * dim);
+    for (size_t i = 0; i < n; ++i) {
+        float norm = 0.0f;
+        for (size_t d = 0; d < dim; ++d) {
+            rows[i * dim + d] = dist(rng);
+            norm += rows[i * dim + d] * rows[i * dim + d];
+        }
+        norm = std::sqrt(norm);
+        for (size_t d = 0; d < dim; ++d) rows[i * dim + d] /= norm;
+    }
+    return rows;
+}
+
+} // namespace test
+
+#define TEST(name)                                              \
+    static void name();                                         \
+    static const test::Register name##_register(#name, name);   \
+    static void name()
+
+#define CHECK(cond)                                                                          \
+    do {                                                                                     \
+        if (!(cond)) {                                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);    \
+            ++test::failures();                                                              \
+        }                                                                                    \
+    } while (0)
+
+#endif // __test_common_hpp__
@@ -0,0 +1,89 @@
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "embedding/db_file.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+// Reference bitwise CRC-32, the table driven one must agree with it
+uint32_t bitwise_crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = ~0u;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; ++k) crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+    }
+    return ~crc;
+}
+
+} // namespace
+
+
+TEST(crc32_check_value) {
+    const char* check = "123456789";
+    CHECK(db_file_crc32(check, 9) == 0xCBF43926u);
+    CHECK(db_file_crc32(check, 0) == 0);
+}
+
+TEST(crc32_matches_the_bitwise_definition) {
+    std::vector<uint8_t> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(i * 131 + 7);
+    // Every length around the 8-byte steps and every misalignment
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t size : {0, 1, 7, 8, 9, 15, 16, 17, 63, 64, 65, 500}) {
+            CHECK(db_file_crc32(data.data() + offset, size) == bitwise_crc32(data.data() + offset, size));
+        }
+    }
+}
+
+TEST(crc32_continues_a_running_checksum) {
+    std::vector<uint8_t> data(777);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(i ^ 0x5A);
+    const uint32_t whole = db_file_crc32(data.data(), data.size());
+    for (size_t split : {0, 1, 3, 8, 100, 776, 777}) {
+        uint32_t crc = db_file_crc32(data.data(), split);
+        CHECK(db_file_crc32(data.data() + split, data.size() - split, crc) == whole);
+    }
+}
+
+TEST(header_checksum_covers_every_field_but_itself) {
+    DBFileHeader header{};
+    std::memcpy(header.magic, DB_FILE_MAGIC, sizeof(header.magic));
+    header.version = DB_FILE_VERSION;
+    header.dim = 128;
+    header.checksum = 0x1234;
+    const uint32_t crc = db_file_header_crc32(header);
+
+    DBFileHeader stored = header;
+    stored.header_checksum = crc;
+    CHECK(db_file_header_crc32(stored) == crc);
+
+    DBFileHeader changed = stored;
+    changed.dim = 129;
+    CHECK(db_file_header_crc32(changed) != crc);
+    changed = stored;
+    changed.checksum = 0x1235;
+    CHECK(db_file_header_crc32(changed) != crc);
+}
+
+TEST(mapped_file_views_the_whole_file) {
+    const std::string filename = test::temp_path("mapped.bin");
+    {
+        std::ofstream ofs(filename, std::ios::binary);
+        ofs << "mapped file contents";
+    }
+    CHECK(db_file_sync(filename));
+    auto file = MappedFile::open(filename);
+    CHECK(file != nullptr);
+    if (file) {
+        CHECK(file->size() == 20);
+        CHECK(std::memcmp(file->data(), "mapped file contents", 20) == 0);
+    }
+    test::remove_files(filename);
+    CHECK(MappedFile::open(filename) == nullptr);
+    CHECK(!db_file_sync(filename));
+}
+
+
+int main() { return test::run(); }
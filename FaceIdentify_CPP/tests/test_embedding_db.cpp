@@ -0,0 +1,685 @@
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include <sys/resource.h>
+
+#include "embedding/embedding_db.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+constexpr size_t DIM = 32;
+
+using DB = EmbeddingDB<std::string>;
+
+std::string person(size_t i) {
+    return "person" + std::to_string(i);
+}
+
+std::vector<float> row(const std::vector<float>& rows, size_t i) {
+    return std::vector<float>(rows.begin() + i * DIM, rows.begin() + (i + 1) * DIM);
+}
+
+// Insert rows one by one, row i with info person(i)
+void fill(DB& db, const std::vector<float>& rows) {
+    for (size_t i = 0; i < rows.size() / DIM; ++i) CHECK(db.insert(row(rows, i), person(i)));
+}
+
+// Same indices in the same order, distances equal up to float rounding
+bool close_results(const std::vector<std::pair<size_t, double>>& a, const std::vector<std::pair<size_t, double>>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].first != b[i].first || std::abs(a[i].second - b[i].second) > 1e-6) return false;
+    }
+    return true;
+}
+
+// (slot, cosine distance) of every live slot, nearest first
+std::vector<std::pair<size_t, double>> brute_force(const DB& db, const std::vector<float>& query) {
+    auto snapshot = db.snapshot();
+    Eigen::Map<const Eigen::RowVectorXf> q(query.data(), DIM);
+    std::vector<std::pair<size_t, double>> results;
+    for (size_t i = 0; i < snapshot->slots(); ++i) {
+        if (snapshot->is_erased(i)) continue;
+        double dot = snapshot->embeddings().row(i).dot(q);
+        results.emplace_back(i, 1.0 - dot / q.norm());
+    }
+    std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+    return results;
+}
+
+// Infos of the live slots in slot order
+std::vector<std::string> live_infos(const DB& db) {
+    auto snapshot = db.snapshot();
+    std::vector<std::string> infos;
+    for (size_t i = 0; i < snapshot->slots(); ++i) {
+        if (!snapshot->is_erased(i)) infos.push_back(snapshot->info(i));
+    }
+    return infos;
+}
+
+std::vector<char> read_file(const std::string& filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string& filename, const std::vector<char>& bytes) {
+    std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+    ofs.write(bytes.data(), bytes.size());
+}
+
+} // namespace
+
+
+TEST(queries_match_a_brute_force_scan) {
+    const std::vector<float> rows = test::random_rows(500, DIM, 13);
+    const std::vector<float> queries = test::random_rows(20, DIM, 14);
+    DB db(DIM);
+    fill(db, rows);
+    // A few erased slots, which no query may return
+    CHECK(db.erase(std::vector<size_t>{0, 10, 250}));
+
+    Eigen::MatrixXf batch(20, DIM);
+    for (size_t q = 0; q < 20; ++q) {
+        const std::vector<float> query = row(queries, q);
+        batch.row(q) = Eigen::Map<const Eigen::RowVectorXf>(query.data(), DIM);
+        const std::vector<std::pair<size_t, double>> expected = brute_force(db, query);
+
+        auto nearest = db.query_nearest(query);
+        CHECK(nearest.first == expected.front().first);
+        CHECK(std::abs(nearest.second - expected.front().second) < 1e-5);
+
+        auto topk = db.query_topk(query, 10);
+        CHECK(close_results(topk, std::vector<std::pair<size_t, double>>(expected.begin(), expected.begin() + 10)));
+
+        // Radius through the 25th neighbour, halfway to the 26th so rounding cannot move the edge
+        const double radius = (expected[24].second + expected[25].second) / 2;
+        auto within = db.query_radius(query, radius);
+        CHECK(close_results(within, std::vector<std::pair<size_t, double>>(expected.begin(), expected.begin() + 25)));
+    }
+
+    auto nearest = db.query_nearest_batch(batch);
+    CHECK(nearest.size() == 20);
+    for (size_t q = 0; q < 20; ++q) CHECK(nearest[q].first == db.query_nearest(row(queries, q)).first);
+}
+
+TEST(queries_handle_edge_cases) {
+    DB db(DIM);
+    const std::vector<float> rows = test::random_rows(5, DIM, 15);
+    bool threw = false;
+    try {
+        db.query_nearest(row(rows, 0));
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+
+    fill(db, rows);
+    CHECK(db.query_topk(row(rows, 0), 0).empty());
+    // k beyond the live rows returns every live row
+    CHECK(db.erase(size_t{2}));
+    CHECK(db.query_topk(row(rows, 0), 50).size() == 4);
+    CHECK(db.query_radius(row(rows, 0), -1.0).empty());
+    CHECK(db.query_radius(row(rows, 0), 2.0).size() == 4);
+
+    threw = false;
+    try {
+        db.query_topk(std::vector<float>(DIM + 1, 0.0f), 1);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(!db.insert(std::vector<float>(DIM + 1, 0.0f), std::string("wrong dim")));
+
+    // Distances ignore the scale of the stored and the query embedding
+    std::vector<float> scaled = row(rows, 3);
+    for (float& x : scaled) x *= 7.0f;
+    auto nearest = db.query_nearest(scaled);
+    CHECK(nearest.first == 3);
+    CHECK(std::abs(nearest.second) < 1e-5);
+    CHECK(db.embedding(3).isApprox(Eigen::Map<const Eigen::RowVectorXf>(rows.data() + 3 * DIM, DIM)));
+}
+TEST(erase_tombstones_until_the_compaction_ratio) {
+    const std::vector<float> rows = test::random_rows(20, DIM, 19);
+    DB db(DIM);
+    db.reserve(64);
+    CHECK(db.capacity() >= 64);
+    fill(db, rows);
+    CHECK(db.capacity() >= 64);
+
+    CHECK(db.erase(size_t{2}));
+    CHECK(!db.erase(size_t{2}));
+    CHECK(!db.erase(size_t{20}));
+    CHECK(db.is_erased(2));
+    CHECK(db.size() == 19);
+    // Repeated and unknown entries erase what they can and report false
+    CHECK(!db.erase(std::vector<size_t>{4, 4}));
+    CHECK(!db.erase(std::vector<std::string>{person(6), std::string("nobody")}));
+    CHECK(db.erase(person(8)));
+    CHECK(db.size() == 16);
+    CHECK(db.slots() == 20);
+    CHECK(db.info(9) == person(9));
+
+    // The fifth erased slot reaches a quarter of the slots, the live rows move down in order
+    CHECK(db.erase(person(10)));
+    CHECK(db.slots() == 15);
+    CHECK(db.size() == 15);
+    std::vector<std::string> expected;
+    for (size_t i = 0; i < 20; ++i) {
+        if (i > 10 || i % 2 == 1 || i == 0) expected.push_back(person(i));
+    }
+    CHECK(live_infos(db) == expected);
+    CHECK(db.query_nearest(row(rows, 19)).first == 14);
+
+    // Inserts after a compaction append behind the packed rows
+    CHECK(db.insert(row(rows, 2), person(2)));
+    CHECK(db.info(15) == person(2));
+    CHECK(db.query_nearest(row(rows, 2)).first == 15);
+}
+
+TEST(snapshots_keep_their_version) {
+    const std::vector<float> rows = test::random_rows(40, DIM, 20);
+    DB db(DIM);
+    fill(db, std::vector<float>(rows.begin(), rows.begin() + 20 * DIM));
+    auto before = db.snapshot();
+    const std::vector<std::string> infos = live_infos(db);
+    const auto nearest = before->query_nearest(row(rows, 5));
+
+    for (size_t i = 20; i < 40; ++i) CHECK(db.insert(row(rows, i), person(i)));
+    CHECK(db.erase(std::vector<size_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+    db.compact();
+    CHECK(db.slots() == 30);
+
+    // The old snapshot still sees its 20 rows, none erased, at their old slots
+    CHECK(before->size() == 20);
+    CHECK(before->slots() == 20);
+    for (size_t i = 0; i < 20; ++i) CHECK(!before->is_erased(i));
+    CHECK(std::vector<std::string>(before->infos().begin(), before->infos().end()) == infos);
+    CHECK(before->query_nearest(row(rows, 5)) == nearest);
+    CHECK(before->info(5) == person(5));
+    CHECK(db.snapshot()->info(0) == person(10));
+}
+
+TEST(readers_run_alongside_the_writer) {
+    const std::vector<float> rows = test::random_rows(400, DIM, 21);
+    const std::vector<float> queries = test::random_rows(16, DIM, 22);
+    for (bool indexed : {false, true}) {
+        DB db(DIM);
+        if (indexed) {
+            db.enable_hnsw();
+            db.enable_quantization(QuantizedRows::Mode::INT8, 8);
+        }
+        fill(db, std::vector<float>(rows.begin(), rows.begin() + 50 * DIM));
+
+        std::atomic<bool> writing = true;
+        std::atomic<size_t> failures = 0;
+        std::vector<std::thread> readers;
+        for (size_t r = 0; r < 4; ++r) {
+            readers.emplace_back([&, r] {
+                size_t q = r;
+                while (writing.load()) {
+                    // Every result names a live row of the snapshot it came from, with its own distance
+                    auto snapshot = db.snapshot();
+                    const std::vector<float> query = row(queries, q++ % 16);
+                    Eigen::Map<const Eigen::RowVectorXf> qv(query.data(), DIM);
+                    for (const auto& [idx, distance] : snapshot->query_topk(query, 5)) {
+                        bool valid = idx < snapshot->slots() && !snapshot->is_erased(idx) &&
+                                     std::abs(1.0 - snapshot->embeddings().row(idx).dot(qv) - distance) < 1e-4;
+                        if (!valid) failures.fetch_add(1);
+                    }
+                }
+            });
+        }
+
+        size_t erased = 0;
+        for (size_t i = 50; i < 400; ++i) {
+            CHECK(db.insert(row(rows, i), person(i)));
+            if (i % 4 == 0) {
+                CHECK(db.erase(person(i - 25)));
+                ++erased;
+            }
+        }
+        writing = false;
+        for (auto& reader : readers) reader.join();
+        CHECK(failures.load() == 0);
+        CHECK(db.size() == 400 - erased);
+    }
+}
+
+TEST(hnsw_queries_follow_erases_and_compactions) {
+    const std::vector<float> rows = test::random_rows(600, DIM, 16);
+    DB db(DIM);
+    db.enable_hnsw();
+    fill(db, rows);
+    CHECK(db.hnsw_enabled());
+
+    // Erasing a third compacts the rows, the rebuilt graph answers with the new slot numbers
+    std::vector<std::string> erased;
+    for (size_t i = 0; i < 600; i += 3) erased.push_back(person(i));
+    CHECK(db.erase(erased));
+    CHECK(db.slots() == 400);
+
+    size_t queries = 0, found = 0;
+    for (size_t i = 1; i < 600; i += 7) {
+        if (i % 3 == 0) continue;
+        auto topk = db.query_topk(row(rows, i), 5);
+        CHECK(topk.size() == 5);
+        found += db.info(topk.front().first) == person(i);
+        ++queries;
+    }
+    CHECK(found == queries);
+    for (size_t i = 0; i < 600; i += 3) {
+        auto [idx, distance] = db.query_nearest(row(rows, i));
+        CHECK(std::find(erased.begin(), erased.end(), db.info(idx)) == erased.end());
+    }
+}
+
+TEST(hnsw_graph_is_stored_and_rebuilt_when_stale) {
+    const std::string filename = test::temp_path("graph.db");
+    const std::string other = test::temp_path("other_graph.db");
+    const std::vector<float> rows = test::random_rows(300, DIM, 17);
+    DB db(DIM);
+    db.enable_hnsw();
+    fill(db, rows);
+    CHECK(db.store(filename));
+    CHECK(std::filesystem::exists(filename + ".hnsw"));
+
+    DB other_db(DIM);
+    other_db.enable_hnsw();
+    fill(other_db, test::random_rows(300, DIM, 18));
+    CHECK(other_db.store(other));
+
+    // The matching graph, then the graph of another database of the same size
+    for (bool stale : {false, true}) {
+        if (stale) std::filesystem::copy_file(other + ".hnsw", filename + ".hnsw",
+                                              std::filesystem::copy_options::overwrite_existing);
+        DB loaded(DIM);
+        loaded.enable_hnsw();
+        CHECK(loaded.load(filename));
+        size_t found = 0;
+        for (size_t i = 0; i < 300; i += 10) found += loaded.info(loaded.query_topk(row(rows, i), 1).front().first) == person(i);
+        CHECK(found == 30);
+    }
+    test::remove_files(filename);
+    test::remove_files(other);
+}
+
+TEST(quantized_scans_agree_with_the_fp32_scan) {
+    const std::vector<float> rows = test::random_rows(1000, DIM, 1);
+    const std::vector<float> queries = test::random_rows(30, DIM, 2);
+    DB flat(DIM);
+    fill(flat, rows);
+
+    for (auto mode : {QuantizedRows::Mode::FP16, QuantizedRows::Mode::INT8}) {
+        DB quantized(DIM);
+        fill(quantized, rows);
+        quantized.enable_quantization(mode, 32);
+        CHECK(quantized.snapshot()->quantized() != nullptr);
+        for (size_t q = 0; q < 30; ++q) {
+            const std::vector<float> query = row(queries, q);
+            // The fp32 rerank of the candidates gives back the exact order and distances
+            CHECK(close_results(quantized.query_topk(query, 5), flat.query_topk(query, 5)));
+            auto [idx, distance] = quantized.query_nearest(query);
+            auto [flat_idx, flat_distance] = flat.query_nearest(query);
+            CHECK(idx == flat_idx);
+            CHECK(std::abs(distance - flat_distance) < 1e-6);
+        }
+        // Stored rows are their own nearest neighbour
+        for (size_t i = 0; i < 1000; i += 37) CHECK(quantized.query_nearest(row(rows, i)).first == i);
+    }
+}
+
+TEST(parallel_scan_matches_the_single_threaded_scan) {
+    const std::vector<float> rows = test::random_rows(3000, DIM, 23);
+    const std::vector<float> queries = test::random_rows(10, DIM, 24);
+    DB serial(DIM);
+    fill(serial, rows);
+    CHECK(serial.erase(std::vector<size_t>{7, 700, 2999}));
+
+    for (auto mode : {QuantizedRows::Mode::NONE, QuantizedRows::Mode::FP16}) {
+        DB parallel(DIM);
+        fill(parallel, rows);
+        CHECK(parallel.erase(std::vector<size_t>{7, 700, 2999}));
+        if (mode != QuantizedRows::Mode::NONE) {
+            parallel.enable_quantization(mode, 32);
+            serial.enable_quantization(mode, 32);
+        }
+        // Small shards so the scan splits into many tasks
+        parallel.enable_parallel_scan(4, 100, 64 * sizeof(float) * DIM);
+
+        Eigen::MatrixXf batch(10, DIM);
+        for (size_t q = 0; q < 10; ++q) {
+            const std::vector<float> query = row(queries, q);
+            batch.row(q) = Eigen::Map<const Eigen::RowVectorXf>(query.data(), DIM);
+            auto nearest = parallel.query_nearest(query);
+            CHECK(nearest.first == serial.query_nearest(query).first);
+            CHECK(close_results(parallel.query_topk(query, 20), serial.query_topk(query, 20)));
+            CHECK(close_results(parallel.query_radius(query, 0.8), serial.query_radius(query, 0.8)));
+        }
+        auto parallel_batch = parallel.query_nearest_batch(batch);
+        auto serial_batch = serial.query_nearest_batch(batch);
+        for (size_t q = 0; q < 10; ++q) CHECK(parallel_batch[q].first == serial_batch[q].first);
+        serial.disable_quantization();
+    }
+}
+
+TEST(parallel_scan_serves_concurrent_queries) {
+    const std::vector<float> rows = test::random_rows(2000, DIM, 25);
+    DB db(DIM);
+    fill(db, rows);
+    db.enable_parallel_scan(3, 100, 64 * sizeof(float) * DIM);
+    // The pool runs one query at a time, the others scan inline
+    std::atomic<size_t> wrong = 0;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t i = t; i < 2000; i += 40) {
+                if (db.query_nearest(row(rows, i)).first != i) wrong.fetch_add(1);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    CHECK(wrong.load() == 0);
+    db.disable_parallel_scan();
+    CHECK(db.query_nearest(row(rows, 5)).first == 5);
+}
+
+TEST(store_and_load_round_trip) {
+    const std::string filename = test::temp_path("round_trip.db");
+    const std::vector<float> rows = test::random_rows(200, DIM, 3);
+    DB db(DIM);
+    fill(db, rows);
+    CHECK(db.erase(std::vector<size_t>{5, 17}));
+    CHECK(db.store(filename));
+    // The rows were compacted like the file
+    CHECK(db.slots() == 198);
+
+    for (bool verify : {false, true}) {
+        DB loaded(DIM);
+        CHECK(loaded.load(filename, verify));
+        CHECK(loaded.is_mapped());
+        CHECK(loaded.size() == 198);
+        CHECK(loaded.slots() == 198);
+        // Live rows keep their order, the erased ones are gone from the file
+        for (size_t i = 0, slot = 0; i < 200; ++i) {
+            if (i == 5 || i == 17) continue;
+            CHECK(loaded.info(slot) == person(i));
+            CHECK(loaded.embedding(slot).isApprox(Eigen::Map<const Eigen::RowVectorXf>(rows.data() + i * DIM, DIM)));
+            ++slot;
+        }
+        CHECK(loaded.snapshot()->info(loaded.query_nearest(row(rows, 100)).first) == person(100));
+    }
+    test::remove_files(filename);
+}
+
+TEST(load_rejects_corrupt_headers) {
+    const std::string filename = test::temp_path("corrupt_header.db");
+    const std::vector<float> rows = test::random_rows(50, DIM, 4);
+    DB db(DIM);
+    fill(db, rows);
+    CHECK(db.store(filename));
+    const std::vector<char> good = read_file(filename);
+
+    auto loads = [&](const std::vector<char>& bytes, bool verify = false) {
+        write_file(filename, bytes);
+        DB loaded(DIM);
+        bool ok = loaded.load(filename, verify);
+        // A rejected file leaves an empty database
+        CHECK(ok || loaded.size() == 0);
+        return ok;
+    };
+    CHECK(loads(good, true));
+
+    // Any header byte, the magic aside which makes it a legacy file
+    for (size_t offset = sizeof(DB_FILE_MAGIC); offset < sizeof(DBFileHeader); ++offset) {
+        std::vector<char> bytes = good;
+        bytes[offset] ^= 0x10;
+        CHECK(!loads(bytes));
+    }
+
+    // Hostile layouts behind a valid header checksum
+    auto with_header = [&](auto change) {
+        std::vector<char> bytes = good;
+        DBFileHeader header;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        change(header);
+        header.header_checksum = db_file_header_crc32(header);
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        return bytes;
+    };
+    CHECK(!loads(with_header([](DBFileHeader& h) { std::swap(h.rows_offset, h.norms_offset); })));
+    CHECK(!loads(with_header([](DBFileHeader& h) { h.rows_offset = 0; })));
+    CHECK(!loads(with_header([](DBFileHeader& h) { h.infos_offset = h.file_size + DB_FILE_ALIGNMENT; })));
+    CHECK(!loads(with_header([](DBFileHeader& h) { h.count = uint64_t{1} << 62; })));
+    CHECK(!loads(with_header([](DBFileHeader& h) { h.count += 1; })));
+    CHECK(!loads(with_header([](DBFileHeader& h) { h.dim = uint64_t{1} << 62; h.count = 4; })));
+    CHECK(!loads(with_header([](DBFileHeader& h) { h.norms_offset = h.infos_offset + DB_FILE_ALIGNMENT; })));
+    CHECK(!loads(with_header([](DBFileHeader& h) { h.version = DB_FILE_VERSION + 1; })));
+    CHECK(!loads(with_header([](DBFileHeader& h) { h.version = DB_FILE_VERSION - 1; })));
+    test::remove_files(filename);
+}
+
+TEST(full_verification_catches_damaged_rows) {
+    const std::string filename = test::temp_path("damaged_rows.db");
+    DB db(DIM);
+    fill(db, test::random_rows(50, DIM, 5));
+    CHECK(db.store(filename));
+    std::vector<char> bytes = read_file(filename);
+    DBFileHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    bytes[header.rows_offset + 3] ^= 0x01;
+    write_file(filename, bytes);
+
+    DB loaded(DIM);
+    CHECK(!loaded.load(filename));
+    // Without full verification only the header is checked
+    CHECK(loaded.load(filename, false));
+    CHECK(loaded.size() == 50);
+    test::remove_files(filename);
+}
+
+TEST(journal_slots_follow_a_checkpoint) {
+    // Erase, checkpoint, erase again: the second erase must name the same row in memory and on replay
+    const std::string filename = test::temp_path("checkpoint.db");
+    const std::vector<float> rows = test::random_rows(10, DIM, 7);
+    DB db(DIM);
+    fill(db, rows);
+    CHECK(db.enable_journal(filename));
+    CHECK(db.erase(size_t{3}));
+    CHECK(db.checkpoint());
+    CHECK(db.slots() == 9);
+    CHECK(db.erase(size_t{7}));
+    CHECK(db.erase(person(5)));
+    const std::vector<std::string> expected = live_infos(db);
+    CHECK(expected.size() == 7);
+    CHECK(std::count(expected.begin(), expected.end(), person(3)) == 0);
+    CHECK(std::count(expected.begin(), expected.end(), person(5)) == 0);
+    db.disable_journal();
+
+    DB loaded(DIM);
+    CHECK(loaded.load(filename));
+    CHECK(live_infos(loaded) == expected);
+    test::remove_files(filename);
+}
+
+TEST(journal_replays_inserts_erases_and_compactions) {
+    const std::string filename = test::temp_path("replay.db");
+    const std::vector<float> rows = test::random_rows(120, DIM, 8);
+    DB db(DIM);
+    db.set_compaction_ratio(0.2);
+    CHECK(db.enable_journal(filename, 4));
+    std::mt19937 rng(9);
+    for (size_t i = 0; i < 120; ++i) {
+        CHECK(db.insert(row(rows, i), person(i)));
+        if (i % 3 == 2) {
+            // Erases by index and by info, some of them trigger a compaction
+            std::uniform_int_distribution<size_t> pick(0, db.slots() - 1);
+            size_t idx = pick(rng);
+            while (db.is_erased(idx)) idx = pick(rng);
+            if (i % 2) {
+                CHECK(db.erase(idx));
+            } else {
+                CHECK(db.erase(db.info(idx)));
+            }
+        }
+        if (i == 60) CHECK(db.checkpoint());
+    }
+    db.compact();
+    CHECK(db.erase(std::vector<size_t>{0, 1}));
+    const std::vector<std::string> expected = live_infos(db);
+    const size_t slots = db.slots();
+    db.disable_journal();
+
+    DB loaded(DIM);
+    CHECK(loaded.load(filename));
+    CHECK(loaded.slots() == slots);
+    CHECK(live_infos(loaded) == expected);
+    for (size_t i = 0; i < loaded.slots(); ++i) {
+        if (!loaded.is_erased(i)) CHECK(loaded.embedding(i).isApprox(db.embedding(i)));
+    }
+    // The loaded database continues the same journal
+    CHECK(loaded.enable_journal(filename));
+    CHECK(loaded.insert(row(rows, 0), std::string("again")));
+    loaded.disable_journal();
+    DB reloaded(DIM);
+    CHECK(reloaded.load(filename));
+    CHECK(reloaded.size() == expected.size() + 1);
+    test::remove_files(filename);
+}
+
+TEST(journal_ignores_records_already_in_the_snapshot) {
+    // A crash between writing the snapshot and restarting the journal leaves the old journal
+    const std::string filename = test::temp_path("stale_journal.db");
+    DB db(DIM);
+    fill(db, test::random_rows(20, DIM, 10));
+    CHECK(db.enable_journal(filename));
+    CHECK(db.erase(size_t{4}));
+    const std::vector<char> old_journal = read_file(filename + ".wal");
+    CHECK(db.checkpoint());
+    db.disable_journal();
+    write_file(filename + ".wal", old_journal);
+
+    DB loaded(DIM);
+    CHECK(loaded.load(filename));
+    CHECK(loaded.size() == 19);
+    CHECK(loaded.slots() == 19);
+    test::remove_files(filename);
+}
+
+TEST(journal_drops_a_torn_tail) {
+    const std::string filename = test::temp_path("torn.db");
+    const std::vector<float> rows = test::random_rows(10, DIM, 11);
+    DB db(DIM);
+    CHECK(db.enable_journal(filename));
+    fill(db, rows);
+    db.disable_journal();
+    std::vector<char> journal = read_file(filename + ".wal");
+    journal.resize(journal.size() - 5);
+    write_file(filename + ".wal", journal);
+
+    DB loaded(DIM);
+    CHECK(loaded.load(filename));
+    CHECK(loaded.size() == 9);
+    CHECK(loaded.info(8) == person(8));
+    test::remove_files(filename);
+}
+
+TEST(failed_journal_write_leaves_the_database_unchanged) {
+    const std::string filename = test::temp_path("journal_full.db");
+    const std::vector<float> rows = test::random_rows(6, DIM, 12);
+    DB db(DIM);
+    CHECK(db.enable_journal(filename));
+    fill(db, std::vector<float>(rows.begin(), rows.begin() + 4 * DIM));
+    const uint64_t bytes = db.journal_bytes();
+
+    // Writes past the current journal size fail with EFBIG
+    std::signal(SIGXFSZ, SIG_IGN);
+    rlimit saved;
+    ::getrlimit(RLIMIT_FSIZE, &saved);
+    rlimit limit = saved;
+    limit.rlim_cur = bytes;
+    ::setrlimit(RLIMIT_FSIZE, &limit);
+    bool threw = false;
+    try {
+        db.insert(row(rows, 4), person(4));
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    threw = false;
+    try {
+        db.erase(size_t{0});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    ::setrlimit(RLIMIT_FSIZE, &saved);
+
+    // Neither mutation was applied nor left a record behind
+    CHECK(db.size() == 4);
+    CHECK(db.slots() == 4);
+    CHECK(!db.is_erased(0));
+    CHECK(db.journal_bytes() == bytes);
+    CHECK(db.insert(row(rows, 5), person(5)));
+    db.disable_journal();
+
+    DB loaded(DIM);
+    CHECK(loaded.load(filename));
+    CHECK(live_infos(loaded) == live_infos(db));
+    test::remove_files(filename);
+}
+
+TEST(failed_journal_restart_keeps_acknowledged_writes) {
+    const std::string filename = test::temp_path("restart.db");
+    const std::vector<float> rows = test::random_rows(13, DIM, 13);
+    DB db(DIM);
+    fill(db, std::vector<float>(rows.begin(), rows.begin() + 10 * DIM));
+    CHECK(db.enable_journal(filename));
+
+    // The new journal cannot be written: the old snapshot and journal stay in place and in use
+    std::filesystem::create_directory(filename + ".wal.tmp");
+    CHECK(!db.checkpoint());
+    std::filesystem::remove(filename + ".wal.tmp");
+    CHECK(db.insert(row(rows, 10), person(10)));
+
+    // The new journal cannot take the place of the old one once the snapshot was replaced
+    std::filesystem::remove(filename + ".wal");
+    std::filesystem::create_directory(filename + ".wal");
+    CHECK(!db.checkpoint());
+    bool threw = false;
+    try {
+        db.insert(row(rows, 11), person(11));
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(db.size() == 11);
+    {
+        // Everything acknowledged so far is in the new snapshot
+        DB loaded(DIM);
+        CHECK(loaded.load(filename));
+        CHECK(live_infos(loaded) == live_infos(db));
+    }
+
+    // A later checkpoint starts a new journal
+    std::filesystem::remove(filename + ".wal");
+    CHECK(db.checkpoint());
+    CHECK(db.insert(row(rows, 12), person(12)));
+    db.disable_journal();
+
+    DB loaded(DIM);
+    CHECK(loaded.load(filename));
+    CHECK(loaded.size() == 12);
+    CHECK(live_infos(loaded) == live_infos(db));
+    test::remove_files(filename);
+}
+
+
+int main() { return test::run(); }
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <opencv2/imgproc.hpp>
+
+#include "embedding/face_preprocess.hpp"
+#include "mtcnn/helpers.h"
+#include "test_common.hpp"
+
+namespace {
+
+constexpr int SIZE = 160;
+
+// cv::resize rounds to 8 bits with fixed-point weights, the fused kernel keeps floats
+constexpr float TOLERANCE = 1.5f / 127.5f;
+
+// The pipeline FacePreprocessor replaced: crop with zero padding, to RGB, resize, normalize
+std::vector<float> reference(const cv::Mat& img, const cv::Rect& rect) {
+    cv::Mat face = cropImage(img, rect);
+    if (face.channels() == 3) {
+        cv::cvtColor(face, face, cv::COLOR_BGR2RGB);
+    } else if (face.channels() == 4) {
+        cv::cvtColor(face, face, cv::COLOR_BGRA2RGB);
+    } else {
+        cv::cvtColor(face, face, cv::COLOR_GRAY2RGB);
+    }
+    cv::resize(face, face, cv::Size(SIZE, SIZE), 0, 0, cv::INTER_LINEAR);
+
+    std::vector<float> out(SIZE * SIZE * 3);
+    const uint8_t* src = face.ptr<uint8_t>();
+    for (size_t i = 0; i < out.size(); ++i) out[i] = src[i] / 127.5f - 1.0f;
+    return out;
+}
+
+float max_difference(const std::vector<float>& a, const std::vector<float>& b) {
+    float diff = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) diff = std::max(diff, std::abs(a[i] - b[i]));
+    return diff;
+}
+
+// Smooth frame with some texture, the way faces look, channel c of each pixel differing
+cv::Mat frame(int channels) {
+    cv::Mat noise(240, 320, CV_8UC(channels));
+    cv::randu(noise, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::Mat img;
+    cv::GaussianBlur(noise, img, cv::Size(5, 5), 1.5);
+    return img;
+}
+
+const cv::Rect RECTS[] = {
+    cv::Rect(30, 40, 100, 120),   // inside, downscaled
+    cv::Rect(150, 70, 160, 160),  // inside, same size
+    cv::Rect(150, 20, 41, 57),    // inside, upscaled
+    cv::Rect(-20, -10, 120, 130), // over the top left corner
+    cv::Rect(250, 180, 90, 80),   // over the bottom right corner
+    cv::Rect(400, 300, 50, 50),   // outside the frame, all padding
+};
+
+} // namespace
+
+
+TEST(matches_crop_resize_and_normalize) {
+    FacePreprocessor preprocess(SIZE);
+    std::vector<float> out(SIZE * SIZE * 3);
+    for (int channels : {1, 3, 4}) {
+        const cv::Mat img = frame(channels);
+        for (const cv::Rect& rect : RECTS) {
+            CHECK(preprocess.run(img, rect, out.data()));
+            CHECK(max_difference(out, reference(img, rect)) <= TOLERANCE);
+        }
+    }
+}
+
+TEST(quantizes_the_normalized_values) {
+    FacePreprocessor preprocess(SIZE);
+    const cv::Mat img = frame(3);
+    std::vector<float> values(SIZE * SIZE * 3);
+    std::vector<uint8_t> out(SIZE * SIZE * 3);
+
+    struct Quantization {
+        float scale;
+        int zero_point;
+        bool is_signed;
+    };
+    for (const Quantization& q : {Quantization{1.0f / 128, 0, true}, Quantization{2.0f / 255, 127, false},
+                                  Quantization{1.0f / 64, -3, true}}) {
+        for (const cv::Rect& rect : RECTS) {
+            CHECK(preprocess.run(img, rect, values.data()));
+            CHECK(preprocess.run(img, rect, q.scale, q.zero_point, q.is_signed, out.data()));
+            bool same = true;
+            for (size_t i = 0; i < out.size(); ++i) {
+                int expected = static_cast<int>(std::lrint(values[i] / q.scale)) + q.zero_point;
+                expected = std::min(std::max(expected, q.is_signed ? -128 : 0), q.is_signed ? 127 : 255);
+                same = same && out[i] == static_cast<uint8_t>(expected);
+            }
+            CHECK(same);
+        }
+    }
+}
+
+TEST(empty_rect_leaves_the_output_untouched) {
+    FacePreprocessor preprocess(SIZE);
+    const cv::Mat img = frame(3);
+    std::vector<float> out(SIZE * SIZE * 3, 5.0f);
+    CHECK(!preprocess.run(img, cv::Rect(10, 10, 0, 20), out.data()));
+    CHECK(!preprocess.run(cv::Mat(), cv::Rect(10, 10, 20, 20), out.data()));
+    CHECK(std::all_of(out.begin(), out.end(), [](float v) { return v == 5.0f; }));
+}
+
+TEST(rejects_other_pixel_types) {
+    FacePreprocessor preprocess(SIZE);
+    std::vector<float> out(SIZE * SIZE * 3);
+    bool thrown = false;
+    try {
+        preprocess.run(cv::Mat(240, 320, CV_32FC3, cv::Scalar::all(0)), cv::Rect(0, 0, 50, 50), out.data());
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+
+int main() { return test::run(); }
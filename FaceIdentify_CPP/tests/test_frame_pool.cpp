@@ -0,0 +1,104 @@
+#include <thread>
+#include <vector>
+
+#include "frame_pool.hpp"
+#include "test_common.hpp"
+
+
+TEST(released_buffers_are_reused) {
+    FramePool pool;
+    std::shared_ptr<cv::Mat> mat = pool.acquire();
+    CHECK(mat->empty());
+    CHECK(pool.allocated() == 1);
+    mat->create(4, 4, CV_8UC1);
+    mat->setTo(cv::Scalar(7));
+    const uint8_t* pixels = mat->data;
+    mat.reset();
+    CHECK(pool.available() == 1);
+
+    // The next frame of the same size lands in the same pixels, still holding the previous frame
+    mat = pool.acquire();
+    CHECK(pool.allocated() == 1);
+    CHECK(pool.available() == 0);
+    CHECK(mat->data == pixels);
+    CHECK(mat->at<uint8_t>(0, 0) == 7);
+    mat->create(4, 4, CV_8UC1);
+    CHECK(mat->data == pixels);
+}
+
+TEST(shared_frame_returns_with_its_last_reference) {
+    FramePool pool;
+    std::shared_ptr<cv::Mat> mat = pool.acquire();
+    mat->create(2, 2, CV_8UC1);
+    FramePool::Frame frame = std::move(mat);
+    FramePool::Frame reader = frame;
+
+    frame.reset();
+    CHECK(pool.available() == 0);
+    reader.reset();
+    CHECK(pool.available() == 1);
+}
+
+TEST(header_copies_keep_their_pixels) {
+    FramePool pool;
+    std::shared_ptr<cv::Mat> mat = pool.acquire();
+    mat->create(2, 2, CV_8UC1);
+    mat->setTo(cv::Scalar(3));
+    cv::Mat copy = *mat;
+    mat.reset();
+
+    // The buffer comes back without the pixels the copy still reads, the next writer allocates anew
+    mat = pool.acquire();
+    CHECK(mat->empty());
+    mat->create(2, 2, CV_8UC1);
+    mat->setTo(cv::Scalar(9));
+    CHECK(mat->data != copy.data);
+    CHECK(copy.at<uint8_t>(1, 1) == 3);
+}
+
+TEST(keeps_at_most_max_free_buffers) {
+    FramePool pool(2);
+    std::vector<std::shared_ptr<cv::Mat>> mats;
+    for (int i = 0; i < 5; ++i) mats.push_back(pool.acquire());
+    CHECK(pool.allocated() == 5);
+    mats.clear();
+    CHECK(pool.available() == 2);
+}
+
+TEST(frames_outlive_the_pool) {
+    FramePool::Frame frame;
+    {
+        FramePool pool;
+        std::shared_ptr<cv::Mat> mat = pool.acquire();
+        mat->create(2, 2, CV_8UC1);
+        mat->setTo(cv::Scalar(5));
+        frame = std::move(mat);
+    }
+    CHECK(frame->at<uint8_t>(0, 1) == 5);
+    frame.reset();
+}
+
+TEST(threads_acquire_and_release_concurrently) {
+    constexpr int THREADS = 4;
+    FramePool pool(THREADS);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&pool, t] {
+            for (int i = 0; i < 10000; ++i) {
+                std::shared_ptr<cv::Mat> mat = pool.acquire();
+                mat->create(8, 8, CV_8UC1);
+                mat->setTo(cv::Scalar(t));
+                FramePool::Frame frame = std::move(mat);
+                CHECK(frame->at<uint8_t>(7, 7) == t);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    // Never more buffers than frames alive at once
+    CHECK(pool.allocated() <= THREADS);
+    CHECK(pool.available() == pool.allocated());
+}
+
+
+int main() { return test::run(); }
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "embedding/hnsw_index.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+constexpr size_t DIM = 32;
+constexpr size_t COUNT = 2000;
+
+// Byte offsets in a version 2 graph file
+constexpr size_t ENTRY_POINT_OFFSET = 4 + 4 + 4 + 8 + 8 + 8 + 8;
+constexpr size_t FIRST_NODE_OFFSET = ENTRY_POINT_OFFSET + 8 + 4;
+constexpr size_t FIRST_LINK_OFFSET = FIRST_NODE_OFFSET + 8 + 4 + 1 + sizeof(float) * DIM + 4;
+
+float dot(const float* a, const float* b) {
+    float sum = 0.0f;
+    for (size_t d = 0; d < DIM; ++d) sum += a[d] * b[d];
+    return sum;
+}
+
+// Labels of the k rows most similar to query, by exhaustive scan
+std::vector<size_t> exact_topk(const std::vector<float>& rows, const float* query, size_t k,
+                               const std::vector<bool>& erased = {}) {
+    std::vector<std::pair<float, size_t>> scored;
+    for (size_t i = 0; i < rows.size() / DIM; ++i) {
+        if (!erased.empty() && erased[i]) continue;
+        scored.emplace_back(dot(rows.data() + i * DIM, query), i);
+    }
+    std::partial_sort(scored.begin(), scored.begin() + k, scored.end(), std::greater<>());
+    std::vector<size_t> labels;
+    for (size_t i = 0; i < k; ++i) labels.push_back(scored[i].second);
+    return labels;
+}
+
+void build(HNSWIndex& index, const std::vector<float>& rows) {
+    for (size_t i = 0; i < rows.size() / DIM; ++i) index.insert(i, rows.data() + i * DIM);
+}
+
+std::vector<char> read_file(const std::string& filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string& filename, const std::vector<char>& bytes) {
+    std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+    ofs.write(bytes.data(), bytes.size());
+}
+
+template<typename T>
+void patch(std::vector<char>& bytes, size_t offset, T value) {
+    std::memcpy(bytes.data() + offset, &value, sizeof(T));
+}
+
+} // namespace
+
+
+TEST(recall_matches_exhaustive_search) {
+    const std::vector<float> rows = test::random_rows(COUNT, DIM, 1);
+    const std::vector<float> queries = test::random_rows(100, DIM, 2);
+    HNSWIndex index(DIM);
+    build(index, rows);
+    CHECK(index.size() == COUNT);
+
+    const size_t k = 10;
+    size_t found = 0;
+    for (size_t q = 0; q < 100; ++q) {
+        std::vector<size_t> expected = exact_topk(rows, queries.data() + q * DIM, k);
+        auto results = index.search(queries.data() + q * DIM, k);
+        CHECK(results.size() == k);
+        for (size_t i = 1; i < results.size(); ++i) CHECK(results[i - 1].second >= results[i].second);
+        for (const auto& [label, similarity] : results) {
+            found += std::count(expected.begin(), expected.end(), label);
+        }
+    }
+    CHECK(found >= 0.95 * 100 * k);
+}
+
+TEST(erased_labels_are_never_returned) {
+    const std::vector<float> rows = test::random_rows(500, DIM, 3);
+    HNSWIndex index(DIM);
+    build(index, rows);
+
+    std::vector<bool> erased(500, false);
+    for (size_t i = 0; i < 500; i += 3) {
+        CHECK(index.erase(i));
+        erased[i] = true;
+    }
+    CHECK(!index.erase(0));
+    CHECK(index.nodes() == 500);
+
+    for (size_t q = 0; q < 500; q += 7) {
+        auto results = index.search(rows.data() + q * DIM, 5);
+        CHECK(results.size() == 5);
+        for (const auto& [label, similarity] : results) CHECK(!erased[label]);
+        if (!erased[q]) CHECK(results.front().first == q);
+    }
+}
+
+TEST(store_and_load_round_trip) {
+    const std::string filename = test::temp_path("round_trip.hnsw");
+    const std::vector<float> rows = test::random_rows(300, DIM, 4);
+    HNSWIndex index(DIM);
+    build(index, rows);
+    index.erase(10);
+    CHECK(index.store(filename, 0x1234));
+
+    HNSWIndex loaded(DIM);
+    CHECK(loaded.load(filename, 0x1234));
+    CHECK(loaded.size() == index.size());
+    CHECK(loaded.nodes() == index.nodes());
+    for (size_t q = 0; q < 300; q += 11) {
+        CHECK(loaded.search(rows.data() + q * DIM, 5) == index.search(rows.data() + q * DIM, 5));
+    }
+    test::remove_files(filename);
+}
+
+TEST(load_rejects_a_graph_of_other_rows) {
+    const std::string filename = test::temp_path("stale.hnsw");
+    const std::vector<float> rows = test::random_rows(100, DIM, 5);
+    HNSWIndex index(DIM);
+    build(index, rows);
+    CHECK(index.store(filename, 1));
+
+    HNSWIndex loaded(DIM);
+    CHECK(!loaded.load(filename, 2));
+    CHECK(loaded.nodes() == 0);
+    HNSWIndex other_dim(DIM + 1);
+    CHECK(!other_dim.load(filename, 1));
+    test::remove_files(filename);
+}
+
+TEST(load_rejects_damaged_files) {
+    const std::string filename = test::temp_path("damaged.hnsw");
+    const std::vector<float> rows = test::random_rows(100, DIM, 6);
+    HNSWIndex index(DIM);
+    build(index, rows);
+    CHECK(index.store(filename, 7));
+    const std::vector<char> good = read_file(filename);
+
+    auto rejected = [&](const std::vector<char>& bytes) {
+        write_file(filename, bytes);
+        HNSWIndex loaded(DIM);
+        bool ok = loaded.load(filename, 7);
+        return !ok && loaded.nodes() == 0 && loaded.search(rows.data(), 1).empty();
+    };
+
+    std::vector<char> bytes = good;
+    patch<int64_t>(bytes, ENTRY_POINT_OFFSET, 100);
+    CHECK(rejected(bytes));
+
+    bytes = good;
+    patch<int64_t>(bytes, ENTRY_POINT_OFFSET, -1);
+    CHECK(rejected(bytes));
+
+    bytes = good;
+    patch<int32_t>(bytes, ENTRY_POINT_OFFSET + 8, 40);
+    CHECK(rejected(bytes));
+
+    // The first node has at least one link on layer 0
+    bytes = good;
+    patch<uint32_t>(bytes, FIRST_LINK_OFFSET, 100);
+    CHECK(rejected(bytes));
+
+    bytes = good;
+    patch<uint32_t>(bytes, FIRST_LINK_OFFSET - 4, 1000);
+    CHECK(rejected(bytes));
+
+    bytes = good;
+    patch<uint64_t>(bytes, ENTRY_POINT_OFFSET - 8, uint64_t{1} << 40);
+    CHECK(rejected(bytes));
+
+    bytes = good;
+    bytes.resize(bytes.size() / 2);
+    CHECK(rejected(bytes));
+
+    write_file(filename, good);
+    HNSWIndex loaded(DIM);
+    CHECK(loaded.load(filename, 7));
+    test::remove_files(filename);
+}
+
+
+int main() { return test::run(); }
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "mtcnn/nms.h"
+#include "test_common.hpp"
+
+namespace {
+
+struct Box {
+    float x1, y1, x2, y2, score;
+};
+
+// The quadratic NMS the kernel replaced: indices of the kept boxes, highest score first
+std::vector<int> reference_nms(const std::vector<Box>& boxes, float threshold, bool useMin) {
+    std::vector<int> order(boxes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return boxes[a].score > boxes[b].score; });
+
+    auto area = [](const Box& b) { return (b.x2 - b.x1 + 1) * (b.y2 - b.y1 + 1); };
+    std::vector<int> keep;
+    while (!order.empty()) {
+        const Box& best = boxes[order[0]];
+        keep.push_back(order[0]);
+        std::vector<int> rest;
+        for (size_t i = 1; i < order.size(); ++i) {
+            const Box& other = boxes[order[i]];
+            float w = std::max(0.f, std::min(best.x2, other.x2) - std::max(best.x1, other.x1) + 1);
+            float h = std::max(0.f, std::min(best.y2, other.y2) - std::max(best.y1, other.y1) + 1);
+            float inter = w * h;
+            float o = useMin ? inter / std::min(area(best), area(other)) : inter / (area(best) + area(other) - inter);
+            if (o <= threshold) rest.push_back(order[i]);
+        }
+        order.swap(rest);
+    }
+    return keep;
+}
+
+// Clusters of jittered boxes, like the candidates of one face across pyramid scales
+std::vector<Box> random_boxes(size_t n, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> position(0.f, 600.f), size(12.f, 120.f), jitter(-8.f, 8.f);
+    std::uniform_real_distribution<float> score(0.f, 1.f);
+    std::vector<Box> boxes;
+    while (boxes.size() < n) {
+        float x = position(rng), y = position(rng), s = size(rng);
+        for (int k = 0; k < 6 && boxes.size() < n; ++k) {
+            float x1 = std::round(x + jitter(rng)), y1 = std::round(y + jitter(rng));
+            float side = std::round(s + jitter(rng));
+            boxes.push_back({x1, y1, x1 + side, y1 + side, score(rng)});
+        }
+    }
+    return boxes;
+}
+
+std::vector<int> run_nms(NonMaxSuppression& nms, const std::vector<Box>& boxes, float threshold, bool useMin) {
+    nms.clear();
+    for (const Box& b : boxes) nms.add(b.x1, b.y1, b.x2, b.y2, b.score);
+    return nms.run(threshold, useMin);
+}
+
+} // namespace
+
+
+TEST(matches_the_quadratic_reference) {
+    NonMaxSuppression nms;
+    for (uint32_t seed = 1; seed <= 20; ++seed) {
+        const std::vector<Box> boxes = random_boxes(50 * seed, seed);
+        for (float threshold : {0.3f, 0.5f, 0.7f}) {
+            for (bool useMin : {false, true}) {
+                // The same instance is reused across calls, its scratch buffers must not leak state
+                CHECK(run_nms(nms, boxes, threshold, useMin) == reference_nms(boxes, threshold, useMin));
+            }
+        }
+    }
+}
+
+TEST(keeps_disjoint_boxes_by_score) {
+    NonMaxSuppression nms;
+    std::vector<Box> boxes = {{0, 0, 9, 9, 0.2f}, {100, 0, 109, 9, 0.9f}, {0, 100, 9, 109, 0.5f}};
+    CHECK(run_nms(nms, boxes, 0.5f, false) == std::vector<int>({1, 2, 0}));
+}
+
+TEST(drops_overlapped_lower_scores) {
+    NonMaxSuppression nms;
+    // The second box sits inside the first: small IoU, but fully covered by the smaller-box measure
+    std::vector<Box> boxes = {{0, 0, 99, 99, 0.9f}, {10, 10, 29, 29, 0.8f}, {1, 1, 100, 100, 0.7f}};
+    CHECK(run_nms(nms, boxes, 0.5f, false) == std::vector<int>({0, 1}));
+    CHECK(run_nms(nms, boxes, 0.5f, true) == std::vector<int>({0}));
+}
+
+TEST(handles_empty_and_equal_scores) {
+    NonMaxSuppression nms;
+    CHECK(run_nms(nms, {}, 0.5f, false).empty());
+    // Ties keep the order the boxes were added in
+    std::vector<Box> boxes = {{0, 0, 9, 9, 0.5f}, {0, 0, 9, 9, 0.5f}, {50, 50, 59, 59, 0.5f}};
+    CHECK(run_nms(nms, boxes, 0.5f, false) == std::vector<int>({0, 2}));
+    CHECK(nms.size() == 3);
+}
+
+
+int main() { return test::run(); }
@@ -0,0 +1,82 @@
+#include <cmath>
+
+#include "embedding/quantized_rows.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+// Odd so the vector kernels also run their scalar tails
+constexpr size_t DIM = 37;
+
+float dot(const float* a, const float* b) {
+    float sum = 0.0f;
+    for (size_t d = 0; d < DIM; ++d) sum += a[d] * b[d];
+    return sum;
+}
+
+// Largest |approximate - exact| score of every row against every query
+float max_error(QuantizedRows::Mode mode, const std::vector<float>& rows, const std::vector<float>& queries) {
+    const size_t n = rows.size() / DIM;
+    QuantizedRows quantized(DIM, mode);
+    for (size_t i = 0; i < n; ++i) quantized.append(rows.data() + i * DIM);
+
+    float error = 0.0f;
+    std::vector<float> scores(n);
+    for (size_t q = 0; q < queries.size() / DIM; ++q) {
+        quantized.scores(queries.data() + q * DIM, scores.data());
+        for (size_t i = 0; i < n; ++i) {
+            error = std::max(error, std::abs(scores[i] - dot(queries.data() + q * DIM, rows.data() + i * DIM)));
+        }
+    }
+    return error;
+}
+
+} // namespace
+
+
+TEST(half_conversion_round_trips) {
+    for (float value : {0.0f, 1.0f, -1.0f, 0.5f, 0.333251953125f, 65504.0f, -2.0e-5f}) {
+        float back = QuantizedRows::half_to_float(QuantizedRows::float_to_half(value));
+        CHECK(std::abs(back - value) <= std::abs(value) * 1e-3f + 1e-7f);
+    }
+    CHECK(std::isinf(QuantizedRows::half_to_float(QuantizedRows::float_to_half(1.0e6f))));
+}
+
+TEST(fp16_scores_match_fp32) {
+    const std::vector<float> rows = test::random_rows(300, DIM, 1);
+    const std::vector<float> queries = test::random_rows(20, DIM, 2);
+    CHECK(max_error(QuantizedRows::Mode::FP16, rows, queries) < 2e-3f);
+}
+
+TEST(int8_scores_match_fp32) {
+    const std::vector<float> rows = test::random_rows(300, DIM, 3);
+    const std::vector<float> queries = test::random_rows(20, DIM, 4);
+    CHECK(max_error(QuantizedRows::Mode::INT8, rows, queries) < 2e-2f);
+}
+
+TEST(scores_of_a_row_range) {
+    const std::vector<float> rows = test::random_rows(100, DIM, 5);
+    const std::vector<float> query = test::random_rows(1, DIM, 6);
+    for (auto mode : {QuantizedRows::Mode::FP16, QuantizedRows::Mode::INT8}) {
+        QuantizedRows quantized(DIM, mode, 4);
+        for (size_t i = 0; i < 100; ++i) quantized.append(rows.data() + i * DIM);
+        CHECK(quantized.size() == 100);
+        CHECK(quantized.capacity() >= 100);
+
+        std::vector<float> all(100), range(30);
+        quantized.scores(query.data(), all.data());
+        quantized.scores(query.data(), range.data(), 50, 30);
+        for (size_t i = 0; i < 30; ++i) CHECK(range[i] == all[50 + i]);
+
+        // The copy keeps every row and can grow past the original
+        QuantizedRows copy(quantized, 200);
+        CHECK(copy.size() == 100);
+        CHECK(copy.capacity() >= 200);
+        std::vector<float> copied(100);
+        copy.scores(query.data(), copied.data());
+        CHECK(copied == all);
+    }
+}
+
+
+int main() { return test::run(); }
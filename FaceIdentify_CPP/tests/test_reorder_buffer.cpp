@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "reorder_buffer.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+std::vector<int> drain(ReorderBuffer<int>& buffer) {
+    std::vector<int> out;
+    int value = 0;
+    while (buffer.pop(value)) out.push_back(value);
+    return out;
+}
+
+} // namespace
+
+
+TEST(releases_results_in_sequence_order) {
+    ReorderBuffer<int> buffer;
+    CHECK(buffer.push(0, 0));
+    CHECK(buffer.push(2, 2));
+    CHECK(drain(buffer) == std::vector<int>({0}));
+    CHECK(buffer.waiting() == 1);
+
+    CHECK(buffer.push(3, 3));
+    CHECK(drain(buffer).empty());
+    CHECK(buffer.push(1, 1));
+    CHECK(drain(buffer) == std::vector<int>({1, 2, 3}));
+    CHECK(buffer.waiting() == 0);
+    CHECK(buffer.skipped() == 0);
+    CHECK(buffer.late() == 0);
+}
+
+TEST(restores_the_order_of_shuffled_results) {
+    std::vector<int> seqs(1000);
+    std::iota(seqs.begin(), seqs.end(), 0);
+    std::mt19937 rng(1);
+    // Results of several workers: each one is at most a few positions away from its place. The
+    // first block stays in order, the first result pushed starts the sequence.
+    for (size_t i = 8; i < seqs.size(); i += 8) std::shuffle(seqs.begin() + i, seqs.begin() + i + 8, rng);
+
+    ReorderBuffer<int> buffer(16);
+    std::vector<int> released;
+    for (int seq : seqs) {
+        CHECK(buffer.push(seq, seq));
+        for (int value : drain(buffer)) released.push_back(value);
+    }
+    std::vector<int> expected(1000);
+    std::iota(expected.begin(), expected.end(), 0);
+    CHECK(released == expected);
+    CHECK(buffer.skipped() == 0);
+}
+
+TEST(skips_a_lost_result_once_the_window_fills) {
+    ReorderBuffer<int> buffer(3);
+    buffer.push(0, 0);
+    CHECK(drain(buffer) == std::vector<int>({0}));
+
+    // 1 never arrives
+    buffer.push(2, 2);
+    buffer.push(3, 3);
+    CHECK(drain(buffer).empty());
+    buffer.push(4, 4);
+    CHECK(drain(buffer) == std::vector<int>({2, 3, 4}));
+    CHECK(buffer.skipped() == 1);
+
+    // ... until it is too late
+    CHECK(!buffer.push(1, 1));
+    CHECK(buffer.late() == 1);
+    CHECK(drain(buffer).empty());
+}
+
+TEST(starts_from_the_first_sequence_number_pushed) {
+    ReorderBuffer<int> buffer;
+    buffer.push(101, 101);
+    buffer.push(100, 100);
+    CHECK(drain(buffer) == std::vector<int>({101}));
+    CHECK(buffer.late() == 1);
+
+    buffer.push(102, 102);
+    buffer.reset();
+    CHECK(buffer.waiting() == 0);
+    buffer.push(7, 7);
+    buffer.push(8, 8);
+    CHECK(drain(buffer) == std::vector<int>({7, 8}));
+}
+
+
+int main() { return test::run(); }
@@ -0,0 +1,129 @@
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+void push_value(SpscRing<int>& ring, int value) {
+    ring.push([value](int& slot) { slot = value; });
+}
+
+} // namespace
+
+
+TEST(pops_in_push_order) {
+    SpscRing<int> ring(4);
+    CHECK(ring.empty());
+    int out = -1;
+    CHECK(!ring.pop(out));
+    CHECK(out == -1);
+
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 0; i < 3; ++i) push_value(ring, round * 10 + i);
+        CHECK(ring.depth() == 3);
+        for (int i = 0; i < 3; ++i) {
+            CHECK(ring.pop(out));
+            CHECK(out == round * 10 + i);
+        }
+        CHECK(!ring.pop(out));
+    }
+    CHECK(ring.pushed() == 15);
+    CHECK(ring.dropped() == 0);
+}
+
+TEST(full_ring_drops_the_oldest) {
+    SpscRing<int> ring(3);
+    for (int i = 0; i < 10; ++i) push_value(ring, i);
+    CHECK(ring.depth() == 3);
+    CHECK(ring.pushed() == 10);
+    CHECK(ring.dropped() == 7);
+
+    int out = -1;
+    for (int i = 7; i < 10; ++i) {
+        CHECK(ring.pop(out));
+        CHECK(out == i);
+    }
+    CHECK(ring.empty());
+}
+
+TEST(pop_hands_the_previous_value_back) {
+    SpscRing<std::vector<int>> ring(2);
+    ring.push([](std::vector<int>& slot) { slot.assign(1, 1); });
+
+    std::vector<int> out(100, 7);
+    const int* buffer = out.data();
+    CHECK(ring.pop(out));
+    CHECK(out == std::vector<int>(1, 1));
+
+    // Once the ring wraps around, the push into that slot finds the buffer the consumer gave up
+    ring.push([](std::vector<int>& slot) { slot.assign(1, 2); });
+    ring.push([&](std::vector<int>& slot) { CHECK(slot.data() == buffer); slot.assign(1, 3); });
+    CHECK(ring.pop(out));
+    CHECK(out == std::vector<int>(1, 2));
+    CHECK(ring.pop(out));
+    CHECK(out == std::vector<int>(1, 3));
+}
+
+TEST(clear_drops_every_entry) {
+    SpscRing<int> ring(4);
+    for (int i = 0; i < 3; ++i) push_value(ring, i);
+    ring.clear();
+    CHECK(ring.empty());
+    int out = -1;
+    CHECK(!ring.pop(out));
+    push_value(ring, 42);
+    CHECK(ring.pop(out));
+    CHECK(out == 42);
+}
+
+TEST(rejects_a_single_slot) {
+    bool thrown = false;
+    try {
+        SpscRing<int> ring(1);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+TEST(producer_and_consumer_threads) {
+    constexpr int COUNT = 200000;
+    SpscRing<int> ring(8);
+    RingNotifier notifier;
+    ring.set_notifier(&notifier);
+
+    std::atomic<bool> done{false};
+    std::thread producer([&] {
+        for (int i = 0; i < COUNT; ++i) push_value(ring, i);
+        done = true;
+        notifier.notify();
+    });
+
+    // Entries may be dropped but never reordered or duplicated
+    uint64_t popped = 0;
+    int last = -1;
+    bool ordered = true;
+    for (;;) {
+        int out = -1;
+        if (ring.pop(out)) {
+            ordered = ordered && out > last;
+            last = out;
+            ++popped;
+        } else if (done && ring.empty()) {
+            break;
+        } else {
+            notifier.wait_for(std::chrono::milliseconds(10), [&] { return done || !ring.empty(); });
+        }
+    }
+    producer.join();
+
+    CHECK(ordered);
+    CHECK(last == COUNT - 1);
+    CHECK(ring.pushed() == COUNT);
+    CHECK(popped + ring.dropped() == COUNT);
+}
+
+
+int main() { return test::run(); }
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "work_stealing_queue.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+FramePool::Frame new_frame() {
+    return std::make_shared<const cv::Mat>();
+}
+
+// Frames submitted to camera, in submission order
+std::vector<FramePool::Frame> submit_frames(WorkStealingQueue& queue, size_t camera, size_t count) {
+    std::vector<FramePool::Frame> frames;
+    for (size_t i = 0; i < count; ++i) {
+        frames.push_back(new_frame());
+        queue.submit(camera, frames.back());
+    }
+    return frames;
+}
+
+} // namespace
+
+
+TEST(worker_takes_its_cameras_frames_in_order) {
+    WorkStealingQueue queue(2, 1, 8);
+    const auto frames0 = submit_frames(queue, 0, 3);
+    const auto frames1 = submit_frames(queue, 1, 2);
+
+    std::map<size_t, std::vector<FramePool::Frame>> taken;
+    FrameJob job;
+    while (queue.next(0, job, milliseconds(0))) {
+        CHECK(job.seq == taken[job.camera].size());
+        taken[job.camera].push_back(job.frame);
+    }
+    CHECK(taken[0] == frames0);
+    CHECK(taken[1] == frames1);
+    CHECK(queue.submitted(0) == 3);
+    CHECK(queue.taken(0) == 3);
+    CHECK(queue.taken(1) == 2);
+    CHECK(queue.stolen() == 0);
+}
+
+TEST(full_camera_drops_only_its_own_oldest_frame) {
+    WorkStealingQueue queue(2, 1, 2);
+    const auto frames1 = submit_frames(queue, 1, 1);
+    const auto frames0 = submit_frames(queue, 0, 4);
+    CHECK(queue.dropped(0) == 2);
+    CHECK(queue.dropped(1) == 0);
+
+    std::vector<FramePool::Frame> taken;
+    FrameJob job;
+    while (queue.next(0, job, milliseconds(0))) taken.push_back(job.frame);
+    CHECK(taken == std::vector<FramePool::Frame>({frames1[0], frames0[2], frames0[3]}));
+
+    // The dropped frames released their buffers
+    CHECK(frames0[0].use_count() == 1);
+    CHECK(frames0[1].use_count() == 1);
+}
+
+TEST(frames_of_one_camera_spread_over_the_workers) {
+    WorkStealingQueue queue(1, 3, 8);
+    const auto frames = submit_frames(queue, 0, 3);
+
+    // Every worker finds a frame in its own queue, the oldest one first whoever asks first
+    FrameJob job;
+    for (size_t i = 0; i < 3; ++i) {
+        CHECK(queue.next(2 - i, job, milliseconds(0)));
+        CHECK(job.frame == frames[i]);
+        CHECK(job.seq == i);
+    }
+    CHECK(queue.stolen() == 0);
+    CHECK(!queue.next(0, job, milliseconds(0)));
+}
+
+TEST(idle_worker_steals_the_oldest_frame) {
+    WorkStealingQueue queue(1, 3, 8);
+    const auto frames = submit_frames(queue, 0, 3);
+
+    FrameJob job;
+    for (size_t i = 0; i < 3; ++i) {
+        CHECK(queue.next(0, job, milliseconds(0)));
+        CHECK(job.frame == frames[i]);
+        CHECK(job.seq == i);
+    }
+    // Its own ticket, then one from each other worker
+    CHECK(queue.stolen() == 2);
+}
+
+TEST(next_times_out_and_stops) {
+    WorkStealingQueue queue(1, 2, 4);
+    FrameJob job;
+    const auto start = std::chrono::steady_clock::now();
+    CHECK(!queue.next(0, job, milliseconds(20)));
+    CHECK(std::chrono::steady_clock::now() - start >= milliseconds(20));
+
+    // A worker waiting for a frame wakes up on submit, and on stop
+    std::thread worker([&] { CHECK(queue.next(1, job, std::chrono::seconds(10))); });
+    std::this_thread::sleep_for(milliseconds(10));
+    const auto frames = submit_frames(queue, 0, 1);
+    worker.join();
+    CHECK(job.frame == frames[0]);
+
+    std::thread stopped([&] { CHECK(!queue.next(0, job, std::chrono::seconds(10))); });
+    std::this_thread::sleep_for(milliseconds(10));
+    queue.stop();
+    stopped.join();
+    submit_frames(queue, 0, 1);
+    CHECK(!queue.next(0, job, milliseconds(0)));
+}
+
+TEST(clear_releases_waiting_frames) {
+    WorkStealingQueue queue(2, 2, 4);
+    const auto frames = submit_frames(queue, 0, 3);
+    submit_frames(queue, 1, 2);
+    queue.clear();
+    for (const auto& frame : frames) CHECK(frame.use_count() == 1);
+
+    FrameJob job;
+    CHECK(!queue.next(0, job, milliseconds(0)));
+    // The pending counts start over, nothing is dropped below max_pending
+    submit_frames(queue, 0, 4);
+    CHECK(queue.dropped(0) == 0);
+}
+
+TEST(rejects_an_empty_pool) {
+    bool thrown = false;
+    try {
+        WorkStealingQueue queue(1, 0, 4);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+TEST(cameras_and_workers_run_concurrently) {
+    constexpr size_t CAMERAS = 3, WORKERS = 4, FRAMES = 20000;
+    WorkStealingQueue queue(CAMERAS, WORKERS, 4);
+
+    std::vector<std::vector<FramePool::Frame>> frames(CAMERAS);
+    for (auto& camera : frames) {
+        for (size_t i = 0; i < FRAMES; ++i) camera.push_back(new_frame());
+    }
+
+    std::mutex mutex;
+    std::vector<std::vector<std::pair<uint64_t, FramePool::Frame>>> taken(CAMERAS);
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < WORKERS; ++w) {
+        workers.emplace_back([&, w] {
+            FrameJob job;
+            while (queue.next(w, job, std::chrono::seconds(10))) {
+                std::lock_guard<std::mutex> lock(mutex);
+                taken[job.camera].emplace_back(job.seq, std::move(job.frame));
+            }
+        });
+    }
+    std::vector<std::thread> cameras;
+    for (size_t c = 0; c < CAMERAS; ++c) {
+        cameras.emplace_back([&, c] {
+            for (const auto& frame : frames[c]) queue.submit(c, frame);
+        });
+    }
+    for (auto& camera : cameras) camera.join();
+    while (true) {
+        bool drained = true;
+        for (size_t c = 0; c < CAMERAS; ++c) {
+            drained = drained && queue.taken(c) + queue.dropped(c) == FRAMES;
+        }
+        if (drained) break;
+        std::this_thread::yield();
+    }
+    queue.stop();
+    for (auto& worker : workers) worker.join();
+
+    // Every camera numbers its frames 0, 1, 2, ... in capture order, whichever worker took them
+    for (size_t c = 0; c < CAMERAS; ++c) {
+        CHECK(queue.submitted(c) == FRAMES);
+        CHECK(taken[c].size() == queue.taken(c));
+        std::sort(taken[c].begin(), taken[c].end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        size_t position = 0;
+        bool in_order = true;
+        for (size_t seq = 0; seq < taken[c].size(); ++seq) {
+            in_order = in_order && taken[c][seq].first == seq;
+            while (position < FRAMES && frames[c][position] != taken[c][seq].second) ++position;
+            in_order = in_order && position < FRAMES;
+        }
+        CHECK(in_order);
+    }
+}
+
+
+int main() { return test::run(); }